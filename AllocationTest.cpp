@@ -0,0 +1,110 @@
+// Allocation test of the processing chain: drives processBlock and processLinkedBlock through every processing mode,
+// window, overlap, synthesis engine and estimator, switching them in the middle of the stream as the plugin does.
+// Always built with the allocation tracker, so that a heap allocation while processing aborts. Run by ctest.
+//
+// prescient-allocation-test
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <cstdio>
+#include <random>
+#include "LPCeffect.cpp"
+#include "EngineFixtures.cpp"
+
+int main() {
+    juce::ScopedNoDenormals noDenormals;
+    EngineFixtures fixtures;
+    const auto& sustained = fixtures.getFixtures()[0];
+    const auto& gliding = fixtures.getFixtures()[1];
+    // channel 1 shares channel 0's voice, channel 2 its carrier and channel 3 both, so that every reuse path runs
+    constexpr int numChannels = 4;
+    const std::array<const EngineFixtures::Fixture*, numChannels> carrierOf{&gliding, &sustained, &gliding, &gliding};
+    const std::array<const EngineFixtures::Fixture*, numChannels> voiceOf{&gliding, &gliding, &sustained, &gliding};
+    const int length = static_cast<int>(gliding.carrier.size());
+
+    // a leader and its followers, one engine per channel as in the plugin
+    FrameWorker worker;
+    std::vector<std::unique_ptr<LPCeffect>> effects;
+    for (int channel = 0; channel < numChannels; ++channel) {
+        effects.push_back(std::make_unique<LPCeffect>(EngineFixtures::sampleRate));
+        effects.back()->prepare();
+        effects.back()->attachWorker(worker);
+    }
+    effects[0]->setFollowers({effects[1].get(), effects[2].get(), effects[3].get()});
+    worker.start();
+
+    constexpr int maxBlockSize = 1024;
+    std::vector<univector<float>> carriers(numChannels, univector<float>(maxBlockSize));
+    std::vector<univector<float>> voices(numChannels, univector<float>(maxBlockSize));
+    std::vector<univector<float>> outs(numChannels, univector<float>(maxBlockSize));
+    std::array<const float*, numChannels> carrierPointers{};
+    std::array<const float*, numChannels> voicePointers{};
+    std::array<float*, numChannels> outputPointers{};
+    for (int channel = 0; channel < numChannels; ++channel) {
+        carrierPointers[channel] = carriers[channel].data();
+        voicePointers[channel] = voices[channel].data();
+        outputPointers[channel] = outs[channel].data();
+    }
+    // shifted and unshifted voices, the shifter skips the ones close to 1
+    const std::array<std::array<float, 3>, 3> shifts{{{1.f, 1.f, 1.f}, {1.25f, 0.8f, 1.5f}, {1.f, 0.6f, 2.f}}};
+
+    std::mt19937 generator(3);
+    std::uniform_int_distribution<int> blockSizes(1, maxBlockSize);
+    int position = 0;
+    int numSettings = 0;
+    int numBlocks = 0;
+    bool finite = true;
+    for (auto mode : {LPCeffect::ProcessingMode::Realtime, LPCeffect::ProcessingMode::Worker,
+                      LPCeffect::ProcessingMode::Amortized})
+    for (auto windowSize : {LPCeffect::WindowSizeEnum::S, LPCeffect::WindowSizeEnum::M, LPCeffect::WindowSizeEnum::L})
+    for (auto overlap : {LPCeffect::OverlapEnum::Half, LPCeffect::OverlapEnum::ThreeQuarters,
+                         LPCeffect::OverlapEnum::SevenEighths})
+    for (auto synthesis : {LPCeffect::SynthesisEngine::Spectral, LPCeffect::SynthesisEngine::Lattice})
+    for (auto estimator : {LPCeffect::Estimator::Autocorrelation, LPCeffect::Estimator::Burg}) {
+        const auto& shift = shifts[numSettings % shifts.size()];
+        const LPCeffect::Params params{numSettings % 2 == 0 ? 76 : 12, shift[0], shift[1], shift[2],
+                                       numSettings % 4 != 3, 0.9f, synthesis, numSettings % 3 == 0 ? 0.02f : 0.f,
+                                       estimator};
+        // linked and independent channels take turns, as the parallel channels switch does
+        const bool linked = numSettings % 2 == 0;
+
+        // everything from the switches on runs as inside the audio callback
+        ScopedNoAllocation noAllocation;
+        for (auto& effect : effects) {
+            effect->setProcessingMode(mode);
+            effect->setWindowSize(windowSize);
+            effect->setOverlap(overlap);
+        }
+        effects[0]->setLinked(linked);
+        // a few frames of the largest window, in blocks of varying size so that frames end anywhere in a block
+        for (int done = 0; done < 3 * 4096; ++numBlocks) {
+            const int numSamples = blockSizes(generator);
+            for (int channel = 0; channel < numChannels; ++channel)
+                for (int n = 0; n < numSamples; ++n) {
+                    carriers[channel][n] = carrierOf[channel]->carrier[(position + n) % length];
+                    voices[channel][n] = voiceOf[channel]->voice[(position + n) % length];
+                }
+            if (linked)
+                effects[0]->processLinkedBlock(carrierPointers.data(), voicePointers.data(), outputPointers.data(),
+                                               numChannels, numSamples, params);
+            else
+                for (int channel = 0; channel < numChannels; ++channel)
+                    effects[channel]->processBlock(carrierPointers[channel], voicePointers[channel],
+                                                   outputPointers[channel], numSamples, params);
+            for (const auto& out : outs)
+                finite = finite && std::all_of(out.begin(), out.begin() + numSamples, [](float x) {
+                    return std::isfinite(x);
+                });
+            position = (position + numSamples) % length;
+            done += numSamples;
+        }
+        ++numSettings;
+    }
+    worker.stop();
+
+    if (!finite) {
+        std::fprintf(stderr, "the output is not finite\n");
+        return 1;
+    }
+    std::fprintf(stderr, "no allocation in %d settings, %d blocks of %d channels\n", numSettings, numBlocks, numChannels);
+    return 0;
+}
@@ -0,0 +1,192 @@
+#include "AllocationTracker.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#if defined(_MSC_VER)
+#include <malloc.h>
+#endif
+
+// Replacements of the global allocation functions, only compiled into builds with PRESCIENT_CHECK_ALLOCATIONS.
+
+static void failInsideScope(const char* what) {
+    if (ScopedNoAllocation::isActive()) {
+        std::fputs(what, stderr);
+        std::fputs(" inside a no-allocation scope (audio callback or frame worker)\n", stderr);
+        std::abort();
+    }
+}
+
+static void* checkedAllocate(std::size_t size) noexcept {
+    failInsideScope("heap allocation");
+    return std::malloc(size == 0 ? 1 : size);
+}
+
+static void* checkedAllocate(std::size_t size, std::align_val_t alignment) noexcept {
+    failInsideScope("heap allocation");
+    const auto bytes = size == 0 ? 1 : size;
+#if defined(_MSC_VER)
+    return _aligned_malloc(bytes, static_cast<std::size_t>(alignment));
+#else
+    // posix_memalign needs at least the alignment of a pointer
+    const auto align = std::max(static_cast<std::size_t>(alignment), sizeof(void*));
+    void* ptr = nullptr;
+    return posix_memalign(&ptr, align, bytes) == 0 ? ptr : nullptr;
+#endif
+}
+
+static void checkedFree(void* ptr) noexcept {
+    if (ptr != nullptr)
+        failInsideScope("heap deallocation");
+    std::free(ptr);
+}
+
+static void checkedFree(void* ptr, std::align_val_t) noexcept {
+    if (ptr != nullptr)
+        failInsideScope("heap deallocation");
+#if defined(_MSC_VER)
+    _aligned_free(ptr);
+#else
+    std::free(ptr);
+#endif
+}
+
+template <typename... Alignment>
+static void* allocateOrThrow(std::size_t size, Alignment... alignment) {
+    if (void* ptr = checkedAllocate(size, alignment...))
+        return ptr;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size) {
+    return allocateOrThrow(size);
+}
+
+void* operator new[](std::size_t size) {
+    return allocateOrThrow(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return checkedAllocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return checkedAllocate(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return allocateOrThrow(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return checkedAllocate(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return checkedAllocate(size, alignment);
+}
+
+void operator delete(void* ptr) noexcept {
+    checkedFree(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    checkedFree(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    checkedFree(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    checkedFree(ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept {
+    checkedFree(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept {
+    checkedFree(ptr);
+}
+
+void operator delete(void* ptr, std::align_val_t alignment) noexcept {
+    checkedFree(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment) noexcept {
+    checkedFree(ptr, alignment);
+}
+
+void operator delete(void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+    checkedFree(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::size_t, std::align_val_t alignment) noexcept {
+    checkedFree(ptr, alignment);
+}
+
+void operator delete(void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    checkedFree(ptr, alignment);
+}
+
+void operator delete[](void* ptr, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    checkedFree(ptr, alignment);
+}
+
+// KFR allocates its aligned buffers with malloc rather than operator new. With glibc, malloc and friends are
+// replaced as well, forwarding to the C library's own implementation. They take effect where the definitions
+// interpose the C library's, i.e. in the executables; a plugin loaded by a host only checks operator new.
+#if defined(__GLIBC__)
+extern "C" {
+void* __libc_malloc(std::size_t size);
+void* __libc_calloc(std::size_t count, std::size_t size);
+void* __libc_realloc(void* ptr, std::size_t size);
+void* __libc_memalign(std::size_t alignment, std::size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(std::size_t size) noexcept {
+    failInsideScope("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(std::size_t count, std::size_t size) noexcept {
+    failInsideScope("calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, std::size_t size) noexcept {
+    failInsideScope("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void* aligned_alloc(std::size_t alignment, std::size_t size) noexcept {
+    failInsideScope("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+void* memalign(std::size_t alignment, std::size_t size) noexcept {
+    failInsideScope("memalign");
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** ptr, std::size_t alignment, std::size_t size) noexcept {
+    failInsideScope("posix_memalign");
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0)
+        return EINVAL;
+    *ptr = __libc_memalign(alignment, size);
+    return *ptr != nullptr || size == 0 ? 0 : ENOMEM;
+}
+
+void free(void* ptr) noexcept {
+    if (ptr != nullptr)
+        failInsideScope("free");
+    __libc_free(ptr);
+}
+}
+#endif
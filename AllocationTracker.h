@@ -0,0 +1,36 @@
+#pragma once
+
+#ifndef PRESCIENT_CHECK_ALLOCATIONS
+#define PRESCIENT_CHECK_ALLOCATIONS 0
+#endif
+
+/**
+ * @brief Marks a scope in which the current thread must not touch the heap.
+ *
+ * In builds configured with PRESCIENT_CHECK_ALLOCATIONS the global operator new / delete abort when called inside
+ * such a scope (see AllocationTracker.cpp). Otherwise the guard compiles to nothing.
+ */
+class ScopedNoAllocation {
+public:
+#if PRESCIENT_CHECK_ALLOCATIONS
+    ScopedNoAllocation() {
+        ++depth;
+    }
+    ~ScopedNoAllocation() {
+        --depth;
+    }
+
+    static bool isActive() {
+        return depth > 0;
+    }
+
+private:
+    inline static thread_local int depth = 0;
+#else
+    ScopedNoAllocation() {}
+#endif
+
+public:
+    ScopedNoAllocation(const ScopedNoAllocation&) = delete;
+    ScopedNoAllocation& operator=(const ScopedNoAllocation&) = delete;
+};
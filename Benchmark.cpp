@@ -0,0 +1,431 @@
+// Microbenchmarks of the DSP stages, written as JSON in the layout of Google Benchmark so that runs can be compared
+// over time with its tools. The engine benchmarks also report the error of each engine against the reference output.
+//
+// prescient-benchmark [--out results.json] [--filter levinson] [--window 512|1024|2048|4096] [--min-time 0.2]
+//                     [--golden <directory>]
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "LPCeffect.cpp"
+#include "EngineFixtures.cpp"
+
+class LPCbenchmark {
+public:
+    /**
+     * @param windowSize Analysis window of the stages: 512, 1024, 2048 or 4096. The effect has no 512 window, at 512
+     * only the estimators run on shorter frames and the other stages use the effect's shortest window.
+     * @param minTime Shortest measured run of each benchmark, in seconds.
+     * @param filter Only benchmarks whose name contains it are run.
+     */
+    LPCbenchmark(int windowSize, double minTime, juce::String filter);
+
+    /**
+     * @brief Runs all benchmarks, each is printed to stderr as it finishes.
+     */
+    void run();
+
+    /**
+     * @brief The results with the context of the run.
+     */
+    [[nodiscard]] juce::String toJSON() const;
+
+    /**
+     * @brief Compares the reference engine with the golden outputs in the directory, which then serve as the reference
+     * of the engine benchmarks.
+     *
+     * @return False if a golden output is missing or differs, see EngineFixtures::checkGolden.
+     */
+    bool checkGolden(const juce::File& directory);
+
+private:
+    struct Result {
+        juce::String name;
+        juce::int64 iterations;
+        double nanoseconds;
+        // samples or frames per second, 0 where it does not apply
+        double itemsPerSecond;
+        // additional values of the benchmark, written as its user counters
+        std::vector<std::pair<juce::String, double>> counters;
+    };
+
+    /**
+     * @brief Parameters that select an engine, compared with the reference: autocorrelation and spectral division,
+     * always recomputed.
+     */
+    struct Engine {
+        juce::String name;
+        LPCeffect::Params params;
+    };
+
+    /**
+     * @brief Times a benchmark body, doubling the iterations until a run lasts at least minTime.
+     *
+     * @param name Benchmark name, stage/argument.
+     * @param items Samples or frames one iteration processes, 0 if not meaningful.
+     * @param body One iteration, returns a value of its result so that it is not optimized away.
+     */
+    template <typename Body>
+    Result* measure(const juce::String& name, double items, Body&& body);
+
+    void benchmarkAnalysis();
+    void benchmarkEstimators();
+    void benchmarkSynthesis();
+    void benchmarkShift();
+    void benchmarkProcessBlock();
+    void benchmarkStages();
+    void benchmarkEngines();
+
+    static constexpr int sampleRate = EngineFixtures::sampleRate;
+    // the orders of the plugin's modelOrder range
+    static constexpr int orders[] = {6, 12, 24, 36, 48, 64, 76};
+
+    int windowSize;
+    double minTime;
+    juce::String filter;
+    LPCeffect effect{sampleRate};
+    // a second of a sawtooth carrier and a noisy voice
+    univector<float> carrier;
+    univector<float> voice;
+    std::vector<Result> results;
+    volatile float sink = 0.f;
+
+    EngineFixtures fixtures;
+    // reference output of each voicing and fixture, rendered or loaded by checkGolden
+    std::vector<univector<float>> references;
+};
+
+LPCbenchmark::LPCbenchmark(int windowSize, double minTime, juce::String filter)
+    : windowSize(windowSize), minTime(minTime), filter(std::move(filter)) {
+    effect.prepare();
+    effect.setWindowSize(windowSize <= 1024 ? LPCeffect::WindowSizeEnum::S
+                         : windowSize == 4096 ? LPCeffect::WindowSizeEnum::L : LPCeffect::WindowSizeEnum::M);
+    jassert(effect.windowSize == std::max(windowSize, 1024));
+
+    std::mt19937 random(1);
+    std::normal_distribution<float> noise(0.f, 0.05f);
+    carrier.resize(sampleRate);
+    voice.resize(sampleRate);
+    for (int n = 0; n < sampleRate; ++n) {
+        carrier[n] = 0.5f * (2.f * std::fmod(110.f * static_cast<float>(n) / sampleRate, 1.f) - 1.f);
+        voice[n] = 0.3f * std::sin(2.f * 3.1415927f * 220.f * static_cast<float>(n) / sampleRate)
+                   + 0.1f * std::sin(2.f * 3.1415927f * 660.f * static_cast<float>(n) / sampleRate) + noise(random);
+    }
+}
+
+template <typename Body>
+LPCbenchmark::Result* LPCbenchmark::measure(const juce::String& name, double items, Body&& body) {
+    if (!name.contains(filter))
+        return nullptr;
+    using clock = std::chrono::steady_clock;
+    for (juce::int64 iterations = 1;; iterations *= 2) {
+        float result = 0.f;
+        const auto start = clock::now();
+        for (juce::int64 i = 0; i < iterations; ++i)
+            result += body();
+        const std::chrono::duration<double> elapsed = clock::now() - start;
+        sink = result;
+        if (elapsed.count() >= minTime) {
+            const double nanoseconds = 1e9 * elapsed.count() / static_cast<double>(iterations);
+            const double itemsPerSecond = items * static_cast<double>(iterations) / elapsed.count();
+            results.push_back({name, iterations, nanoseconds, itemsPerSecond, {}});
+            std::fprintf(stderr, "%-32s %14.0f ns %12lld\n", name.toRawUTF8(), nanoseconds,
+                         static_cast<long long>(iterations));
+            return &results.back();
+        }
+    }
+}
+
+void LPCbenchmark::run() {
+    juce::ScopedNoDenormals noDenormals;
+    benchmarkAnalysis();
+    benchmarkEstimators();
+    benchmarkSynthesis();
+    benchmarkShift();
+    benchmarkProcessBlock();
+    benchmarkStages();
+    benchmarkEngines();
+}
+
+void LPCbenchmark::benchmarkAnalysis() {
+    const std::span<const float> frame(voice.data(), windowSize);
+    // lags 0 to order, the direct and the FFT paths
+    for (int order : orders)
+        measure("autocorrelation/" + juce::String(order), 1, [&] {
+            effect.autocorrelation(frame, effect.correlation, order + 1);
+            return effect.correlation[order];
+        });
+
+    for (int order : orders) {
+        effect.frameModelOrder = order;
+        effect.autocorrelation(frame, effect.correlation, order + 1);
+        measure("levinsonDurbin/" + juce::String(order), 1, [&] {
+            return effect.levinsonDurbin(effect.correlation, effect.voiceLPC, effect.voiceReflection).predictionError;
+        });
+    }
+
+    // the alternative estimator, on the samples rather than on the autocorrelation
+    for (int order : orders) {
+        effect.frameModelOrder = order;
+        measure("burg/" + juce::String(order), 1, [&] {
+            return effect.burg(frame, effect.voiceLPC, effect.voiceReflection).predictionError;
+        });
+    }
+
+    // carrier analysis and the inverse filter
+    effect.progress.params = LPCeffect::Params{};
+    for (int order : orders) {
+        effect.frameModelOrder = order;
+        measure("getResiduals/" + juce::String(order), effect.windowSize, [&] {
+            effect.getResiduals(std::span<const float>(carrier.data(), effect.windowSize), effect.carrierResiduals);
+            return effect.carrierResiduals[0];
+        });
+    }
+}
+
+void LPCbenchmark::benchmarkEstimators() {
+    // the envelope of one frame with each estimator, autocorrelation and Levinson-Durbin against Burg. Run with
+    // --filter estimator/ at every --window to compare them across window sizes
+    const std::span<const float> frame(voice.data(), windowSize);
+    for (int order : {6, 40, 76}) {
+        effect.frameModelOrder = order;
+        measure("estimator/autocorrelation/" + juce::String(order), 1, [&] {
+            effect.autocorrelation(frame, effect.correlation, order + 1);
+            return effect.levinsonDurbin(effect.correlation, effect.voiceLPC, effect.voiceReflection).predictionError;
+        });
+        measure("estimator/burg/" + juce::String(order), 1, [&] {
+            return effect.burg(frame, effect.voiceLPC, effect.voiceReflection).predictionError;
+        });
+    }
+}
+
+void LPCbenchmark::benchmarkSynthesis() {
+    // frames of the effect's window, the transforms are planned for it
+    const std::span<const float> frame(voice.data(), effect.windowSize);
+    effect.frameModelOrder = 76;
+    effect.autocorrelation(frame, effect.correlation, effect.frameModelOrder + 1);
+    effect.levinsonDurbin(effect.correlation, effect.voiceLPC, effect.voiceReflection);
+    const std::span<const float> carrierFrame(carrier.data(), effect.windowSize);
+
+    measure("FFToperations/Convolution", effect.windowSize, [&] {
+        effect.FFToperations(LPCeffect::FFToperation::Convolution, carrierFrame, effect.voiceLPC, effect.carrierResiduals);
+        return effect.carrierResiduals[0];
+    });
+    measure("FFToperations/IIR", effect.windowSize, [&] {
+        effect.FFToperations(LPCeffect::FFToperation::IIR, carrierFrame, effect.voiceLPC, effect.synthesized);
+        return effect.synthesized[0];
+    });
+
+    std::copy(carrierFrame.begin(), carrierFrame.end(), effect.synthesized.begin());
+    measure("matchPower", effect.windowSize, [&] {
+        effect.matchPower(effect.synthesized, frame);
+        return effect.synthesized[0];
+    });
+}
+
+void LPCbenchmark::benchmarkShift() {
+    // the plugin's path: all voices of a frame in one pass over the shared grains, without allocating
+    const std::span<const float> frame(voice.data(), effect.windowSize);
+    auto& shifter = *effect.shiftEffect;
+    for (int numVoices = 1; numVoices <= ShiftEffect::maxVoices; ++numVoices)
+        for (float shift : {0.6f, 0.8f, 1.25f, 1.5f, 2.f}) {
+            // the other voices a fifth up and a fourth down, 0 leaves a voice out
+            std::array<float, ShiftEffect::maxVoices> shifts{shift, numVoices > 1 ? 1.5f : 0.f, numVoices > 2 ? 0.75f : 0.f};
+            const int grains = shifter.grainCount(effect.windowSize, shifts);
+            auto* result = measure("shift/" + juce::String(numVoices) + "/" + juce::String(shift, 2), effect.windowSize, [&] {
+                ScopedNoAllocation noAllocation;
+                shifter.beginShift(frame, shifts);
+                while (!shifter.shiftGrains(grains));
+                shifter.copyShifted(effect.frameResult);
+                return effect.frameResult[0];
+            });
+            if (result != nullptr)
+                result->counters.emplace_back("grains", grains);
+        }
+}
+
+void LPCbenchmark::benchmarkProcessBlock() {
+    // the whole chain as a host drives it, 1 is sendSample
+    LPCeffect::Params params{76, 1.f, 1.f, 1.f, true, 1.f};
+    univector<float> output(sampleRate);
+    for (int blockSize : {1, 32, 128, 512, 2048}) {
+        effect.restartBuffers();
+        int position = 0;
+        auto* result = measure("processBlock/" + juce::String(blockSize), blockSize, [&] {
+            if (position + blockSize > sampleRate)
+                position = 0;
+            ScopedNoAllocation noAllocation;
+            effect.processBlock(carrier.data() + position, voice.data() + position, output.data() + position,
+                                blockSize, params);
+            position += blockSize;
+            return output[position - 1];
+        });
+        if (result != nullptr)
+            result->counters.emplace_back("realtime_factor", result->itemsPerSecond / sampleRate);
+    }
+}
+
+void LPCbenchmark::benchmarkStages() {
+#if PRESCIENT_TELEMETRY
+    // the effect's own stage probes over ten seconds in blocks of 512, drained after every block so that none drop
+    LPCeffect::Params params{76, 1.f, 1.f, 1.f, true, 1.f};
+    constexpr int blockSize = 512;
+    univector<float> output(blockSize);
+    std::array<double, StageTelemetry::numProbes> microseconds{};
+    std::array<juce::int64, StageTelemetry::numProbes> counts{};
+    auto& telemetry = effect.getTelemetry();
+    StageTelemetry::Sample sample;
+    while (telemetry.pop(sample));
+    effect.restartBuffers();
+    for (int pass = 0; pass < 10; ++pass) {
+        for (int position = 0; position + blockSize <= sampleRate; position += blockSize) {
+            effect.processBlock(carrier.data() + position, voice.data() + position, output.data(), blockSize, params);
+            while (telemetry.pop(sample)) {
+                microseconds[static_cast<size_t>(sample.probe)] += sample.microseconds;
+                ++counts[static_cast<size_t>(sample.probe)];
+            }
+        }
+    }
+    for (int i = 0; i < StageTelemetry::numProbes; ++i) {
+        const auto name = "stage/" + juce::String(StageTelemetry::getName(static_cast<StageTelemetry::Probe>(i)));
+        if (counts[i] == 0 || !name.contains(filter))
+            continue;
+        // the mean time of the stage in a frame
+        const double nanoseconds = 1000.0 * microseconds[i] / static_cast<double>(counts[i]);
+        results.push_back({name, counts[i], nanoseconds, 0.0, {}});
+        std::fprintf(stderr, "%-32s %14.0f ns %12lld\n", name.toRawUTF8(), nanoseconds,
+                     static_cast<long long>(counts[i]));
+    }
+#endif
+}
+
+void LPCbenchmark::benchmarkEngines() {
+    const auto& engineFixtures = fixtures.getFixtures();
+    const auto windowSizeEnum = effect.windowSizeEnum;
+    size_t index = 0;
+    for (const auto& voicing : EngineFixtures::voicings) {
+        const auto reference = EngineFixtures::referenceParams(voicing);
+        std::vector<Engine> engines{{"reference", reference}};
+        auto variant = [&](const juce::String& name, auto change) {
+            engines.push_back({name, reference});
+            change(engines.back().params);
+        };
+        variant("burg", [](auto& params) { params.estimator = LPCeffect::Estimator::Burg; });
+        variant("lattice", [](auto& params) { params.synthesis = LPCeffect::SynthesisEngine::Lattice; });
+        variant("envelopeReuse/0.01", [](auto& params) { params.envelopeReuse = 0.01f; });
+        variant("envelopeReuse/0.05", [](auto& params) { params.envelopeReuse = 0.05f; });
+        variant("burg+lattice", [](auto& params) {
+            params.estimator = LPCeffect::Estimator::Burg;
+            params.synthesis = LPCeffect::SynthesisEngine::Lattice;
+        });
+
+        for (const auto& fixture : engineFixtures) {
+            const size_t i = index++;
+            if (references.size() <= i)
+                references.push_back(EngineFixtures::render(fixture, reference, windowSizeEnum));
+            for (const auto& engine : engines) {
+                const auto name = "engine/" + fixture.name + EngineFixtures::voicingSuffix(voicing) + "/" + engine.name;
+                auto* result = measure(name, static_cast<double>(fixture.carrier.size()), [&] {
+                    return EngineFixtures::render(fixture, engine.params, windowSizeEnum)[0];
+                });
+                if (result == nullptr)
+                    continue;
+                // error against speed
+                const auto output = EngineFixtures::render(fixture, engine.params, windowSizeEnum);
+                const double snr = EngineFixtures::signalToNoise(references[i], output);
+                const double distance = fixtures.spectralDistance(references[i], output);
+                result->counters.emplace_back("realtime_factor", result->itemsPerSecond / sampleRate);
+                result->counters.emplace_back("snr_db", snr);
+                result->counters.emplace_back("spectral_distance_db", distance);
+                std::fprintf(stderr, "%32s %7.1fx realtime %8.1f dB SNR %6.2f dB spectral distance\n", "",
+                             result->itemsPerSecond / sampleRate, snr, distance);
+            }
+        }
+    }
+}
+
+bool LPCbenchmark::checkGolden(const juce::File& directory) {
+    return fixtures.checkGolden(directory, effect.windowSizeEnum, references);
+}
+
+juce::String LPCbenchmark::toJSON() const {
+    auto* context = new juce::DynamicObject();
+    context->setProperty("date", juce::Time::getCurrentTime().toISO8601(true));
+    context->setProperty("host_name", juce::SystemStats::getComputerName());
+    context->setProperty("num_cpus", juce::SystemStats::getNumCpus());
+    context->setProperty("mhz_per_cpu", juce::SystemStats::getCpuSpeedInMegahertz());
+#if JUCE_DEBUG
+    context->setProperty("library_build_type", "debug");
+#else
+    context->setProperty("library_build_type", "release");
+#endif
+    context->setProperty("sample_rate", sampleRate);
+    context->setProperty("window_size", windowSize);
+
+    juce::Array<juce::var> benchmarks;
+    for (const auto& result : results) {
+        auto* benchmark = new juce::DynamicObject();
+        benchmark->setProperty("name", result.name);
+        benchmark->setProperty("run_type", "iteration");
+        benchmark->setProperty("iterations", result.iterations);
+        benchmark->setProperty("real_time", result.nanoseconds);
+        benchmark->setProperty("cpu_time", result.nanoseconds);
+        benchmark->setProperty("time_unit", "ns");
+        if (result.itemsPerSecond > 0.0)
+            benchmark->setProperty("items_per_second", result.itemsPerSecond);
+        for (const auto& [counter, value] : result.counters)
+            benchmark->setProperty(counter, value);
+        benchmarks.add(juce::var(benchmark));
+    }
+
+    auto* root = new juce::DynamicObject();
+    root->setProperty("context", juce::var(context));
+    root->setProperty("benchmarks", benchmarks);
+    return juce::JSON::toString(juce::var(root));
+}
+
+int main(int argc, char* argv[]) {
+    juce::File output;
+    juce::File golden;
+    juce::String filter;
+    int windowSize = 2048;
+    double minTime = 0.2;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        const juce::String option(argv[i]);
+        const juce::String value(argv[i + 1]);
+        if (option == "--out")
+            output = juce::File::getCurrentWorkingDirectory().getChildFile(value);
+        else if (option == "--filter")
+            filter = value;
+        else if (option == "--window")
+            windowSize = value.getIntValue();
+        else if (option == "--min-time")
+            minTime = value.getDoubleValue();
+        else if (option == "--golden")
+            golden = juce::File::getCurrentWorkingDirectory().getChildFile(value);
+        else {
+            std::fprintf(stderr, "unknown option: %s\n", option.toRawUTF8());
+            return 1;
+        }
+    }
+    if (argc % 2 == 0 || (windowSize != 512 && windowSize != 1024 && windowSize != 2048 && windowSize != 4096)) {
+        std::fprintf(stderr, "usage: prescient-benchmark [--out <file.json>] [--filter <name>] "
+                             "[--window 512|1024|2048|4096] [--min-time <seconds>] [--golden <directory>]\n");
+        return 1;
+    }
+
+    LPCbenchmark benchmark(windowSize, minTime, filter);
+    // the golden outputs become the reference of the engines, so a regression shows in every engine's error
+    const bool matchesGolden = golden == juce::File() || benchmark.checkGolden(golden);
+    benchmark.run();
+    const auto json = benchmark.toJSON();
+    if (output == juce::File())
+        std::printf("%s\n", json.toRawUTF8());
+    else if (!output.replaceWithText(json)) {
+        std::fprintf(stderr, "cannot write %s\n", output.getFullPathName().toRawUTF8());
+        return 1;
+    }
+    return matchesGolden ? 0 : 1;
+}
@@ -0,0 +1,159 @@
+#include "EngineFixtures.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+EngineFixtures::EngineFixtures() {
+    std::mt19937 generator(7);
+    auto uniformNoise = [&generator] {
+        return static_cast<float>(generator()) / 2147483648.f - 1.f;
+    };
+    const int length = 2 * sampleRate;
+    // a sustained vowel over a sawtooth chord
+    Fixture sustained{"sustained", univector<float>(length), univector<float>(length)};
+    // a voice gliding an octave up with syllables and a pause, over noise and a sawtooth
+    Fixture gliding{"gliding", univector<float>(length), univector<float>(length)};
+    double phase = 0.0;
+    for (int n = 0; n < length; ++n) {
+        const double t = static_cast<double>(n) / sampleRate;
+        auto saw = [t](double frequency) {
+            return static_cast<float>(2.0 * std::fmod(frequency * t, 1.0) - 1.0);
+        };
+        sustained.carrier[n] = 0.2f * (saw(110.0) + saw(138.6) + saw(164.8));
+        float vowel = 0.f;
+        for (int harmonic = 1; harmonic <= 20; ++harmonic) {
+            // formants around 700 and 1200 Hz
+            const double f = 150.0 * harmonic;
+            const double gain = 1.0 / (1.0 + std::pow((f - 700.0) / 150.0, 2)) + 0.5 / (1.0 + std::pow((f - 1200.0) / 200.0, 2));
+            vowel += static_cast<float>(gain * std::sin(2.0 * 3.14159265358979 * f * t));
+        }
+        sustained.voice[n] = 0.2f * vowel + 0.01f * uniformNoise();
+
+        phase += (120.0 + 120.0 * t / 2.0 + 3.0 * std::sin(2.0 * 3.14159265358979 * 5.0 * t)) / sampleRate;
+        const float syllables = t > 1.2 && t < 1.4 ? 0.f : static_cast<float>(0.5 - 0.5 * std::cos(2.0 * 3.14159265358979 * 3.0 * t));
+        gliding.carrier[n] = 0.3f * saw(55.0) + 0.1f * uniformNoise();
+        gliding.voice[n] = syllables * (0.3f * static_cast<float>(std::sin(2.0 * 3.14159265358979 * phase)
+                                        + 0.5 * std::sin(4.0 * 3.14159265358979 * phase)) + 0.05f * uniformNoise());
+    }
+    fixtures.push_back(std::move(sustained));
+    fixtures.push_back(std::move(gliding));
+    spectrumTemp.resize(spectrumPlan.temp_size);
+}
+
+univector<float> EngineFixtures::render(const Fixture& fixture, const LPCeffect::Params& params,
+                                        LPCeffect::WindowSizeEnum windowSize) {
+    LPCeffect renderer(sampleRate);
+    renderer.prepare();
+    renderer.setWindowSize(windowSize);
+    const int length = static_cast<int>(fixture.carrier.size());
+    const int latency = renderer.getLatency();
+    univector<float> carrierInput(length + latency, 0.f);
+    univector<float> voiceInput(length + latency, 0.f);
+    univector<float> output(length + latency);
+    std::copy(fixture.carrier.begin(), fixture.carrier.end(), carrierInput.begin());
+    std::copy(fixture.voice.begin(), fixture.voice.end(), voiceInput.begin());
+    // in blocks of a typical host
+    constexpr int blockSize = 512;
+    for (int position = 0; position < length + latency; position += blockSize) {
+        // the chain must not allocate, checked in builds with PRESCIENT_CHECK_ALLOCATIONS
+        ScopedNoAllocation noAllocation;
+        renderer.processBlock(carrierInput.data() + position, voiceInput.data() + position, output.data() + position,
+                              std::min(blockSize, length + latency - position), params);
+    }
+    return univector<float>(output.begin() + latency, output.end());
+}
+
+double EngineFixtures::signalToNoise(const univector<float>& reference, const univector<float>& signal) {
+    double power = 0.0;
+    double noise = 0.0;
+    for (size_t n = 0; n < reference.size(); ++n) {
+        power += static_cast<double>(reference[n]) * reference[n];
+        noise += static_cast<double>(signal[n] - reference[n]) * (signal[n] - reference[n]);
+    }
+    // identical outputs are reported as a finite, large ratio so that the JSON stays valid
+    return 10.0 * std::log10(std::max(power, 1e-30) / std::max(noise, 1e-30 * std::max(power, 1e-30)));
+}
+
+double EngineFixtures::spectralDistance(const univector<float>& reference, const univector<float>& signal) {
+    const auto window = window_hann(spectrumSize);
+    univector<float> frame(spectrumSize);
+    univector<std::complex<float>> referenceSpectrum(spectrumSize / 2 + 1);
+    univector<std::complex<float>> signalSpectrum(spectrumSize / 2 + 1);
+    double total = 0.0;
+    int numFrames = 0;
+    for (size_t start = 0; start + spectrumSize <= reference.size(); start += spectrumSize / 2) {
+        for (int n = 0; n < spectrumSize; ++n)
+            frame[n] = reference[start + n] * static_cast<float>(window[n]);
+        spectrumPlan.execute(referenceSpectrum.data(), frame.data(), spectrumTemp.data());
+        for (int n = 0; n < spectrumSize; ++n)
+            frame[n] = signal[start + n] * static_cast<float>(window[n]);
+        spectrumPlan.execute(signalSpectrum.data(), frame.data(), spectrumTemp.data());
+
+        double energy = 0.0;
+        for (const auto& bin : referenceSpectrum)
+            energy += std::norm(bin);
+        // -60 dBFS of a full-scale sine, silent frames say nothing about the envelope
+        if (energy < 1e-6 * spectrumSize * spectrumSize / 8.0)
+            continue;
+        double sum = 0.0;
+        for (size_t bin = 0; bin < referenceSpectrum.size(); ++bin) {
+            const double ratio = 10.0 * std::log10((std::norm(signalSpectrum[bin]) + 1e-12) / (std::norm(referenceSpectrum[bin]) + 1e-12));
+            sum += ratio * ratio;
+        }
+        total += std::sqrt(sum / static_cast<double>(referenceSpectrum.size()));
+        ++numFrames;
+    }
+    return numFrames > 0 ? total / numFrames : 0.0;
+}
+
+juce::File EngineFixtures::goldenFile(const juce::File& directory, const Fixture& fixture, const Voicing& voicing,
+                                      LPCeffect::WindowSizeEnum windowSize) const {
+    const int length = windowSize == LPCeffect::WindowSizeEnum::S ? 1024
+                       : windowSize == LPCeffect::WindowSizeEnum::L ? 4096 : 2048;
+    return directory.getChildFile(fixture.name + voicingSuffix(voicing) + "-" + juce::String(length) + ".f32");
+}
+
+bool EngineFixtures::checkGolden(const juce::File& directory, LPCeffect::WindowSizeEnum windowSize,
+                                 std::vector<univector<float>>& references) {
+    bool passed = true;
+    references.clear();
+    for (const auto& voicing : voicings)
+    for (const auto& fixture : fixtures) {
+        auto output = render(fixture, referenceParams(voicing), windowSize);
+        const auto file = goldenFile(directory, fixture, voicing, windowSize);
+        const auto numBytes = output.size() * sizeof(float);
+        juce::MemoryBlock golden;
+        if (!file.existsAsFile() || !file.loadFileAsData(golden) || golden.getSize() != numBytes) {
+            std::fprintf(stderr, "%s: missing, or not of the output's length\n", file.getFullPathName().toRawUTF8());
+            passed = false;
+            references.push_back(std::move(output));
+            continue;
+        }
+        univector<float> goldenOutput(output.size());
+        std::memcpy(goldenOutput.data(), golden.getData(), numBytes);
+        const double snr = signalToNoise(goldenOutput, output);
+        const double distance = spectralDistance(goldenOutput, output);
+        const bool matches = snr >= goldenTolerance;
+        std::fprintf(stderr, "golden %-24s %8.1f dB SNR %6.2f dB spectral distance %s\n",
+                     file.getFileNameWithoutExtension().toRawUTF8(), snr, distance, matches ? "ok" : "FAILED");
+        passed = passed && matches;
+        references.push_back(std::move(goldenOutput));
+    }
+    return passed;
+}
+
+bool EngineFixtures::writeGolden(const juce::File& directory, LPCeffect::WindowSizeEnum windowSize) const {
+    directory.createDirectory();
+    for (const auto& voicing : voicings)
+    for (const auto& fixture : fixtures) {
+        const auto output = render(fixture, referenceParams(voicing), windowSize);
+        const auto file = goldenFile(directory, fixture, voicing, windowSize);
+        if (!file.replaceWithData(output.data(), output.size() * sizeof(float))) {
+            std::fprintf(stderr, "cannot write %s\n", file.getFullPathName().toRawUTF8());
+            return false;
+        }
+        std::fprintf(stderr, "golden output written: %s\n", file.getFullPathName().toRawUTF8());
+    }
+    return true;
+}
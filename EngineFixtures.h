@@ -0,0 +1,112 @@
+#pragma once
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <array>
+#include <vector>
+#include "LPCeffect.h"
+
+/**
+ * @brief Generated carrier and voice pairs rendered through the whole effect, the measures of an output's error against
+ * a reference and the golden outputs of the reference engine.
+ *
+ * Shared by the engine benchmarks and the golden output test. The fixtures come from fixed generators, so that they
+ * are the same on every machine.
+ */
+class EngineFixtures {
+public:
+    /**
+     * @brief A carrier and voice pair, two seconds each.
+     */
+    struct Fixture {
+        juce::String name;
+        univector<float> carrier;
+        univector<float> voice;
+    };
+
+    inline EngineFixtures();
+
+    [[nodiscard]] const std::vector<Fixture>& getFixtures() const {
+        return fixtures;
+    }
+
+    /**
+     * @brief Voice shifts the golden outputs are kept for. Unshifted voices skip the shifter; the shifted ones run its
+     * grain analysis, phase vocoder kernels and resampling tables for three ratios at once.
+     */
+    struct Voicing {
+        const char* name;
+        std::array<float, ShiftEffect::maxVoices> shifts;
+    };
+    static constexpr std::array<Voicing, 2> voicings{{{"unshifted", {1.f, 1.f, 1.f}}, {"shifted", {1.25f, 0.8f, 1.5f}}}};
+
+    /**
+     * @brief The suffix of a voicing in file and benchmark names. The unshifted voicing has none, so that it keeps the
+     * names it had before the shifted one was added.
+     */
+    static juce::String voicingSuffix(const Voicing& voicing) {
+        return &voicing == &voicings[0] ? juce::String() : "-" + juce::String(voicing.name);
+    }
+
+    /**
+     * @brief The engine the others are compared with: autocorrelation and spectral division, always recomputed.
+     */
+    static LPCeffect::Params referenceParams(const Voicing& voicing = voicings[0]) {
+        return {76, voicing.shifts[0], voicing.shifts[1], voicing.shifts[2], true, 1.f};
+    }
+
+    /**
+     * @brief Renders a fixture through a new effect in blocks of 512, latency removed.
+     *
+     * @param fixture The inputs.
+     * @param params The engine.
+     * @param windowSize The analysis window.
+     *
+     * @return The output, as long as the inputs.
+     */
+    [[nodiscard]] inline static univector<float> render(const Fixture& fixture, const LPCeffect::Params& params,
+                                                        LPCeffect::WindowSizeEnum windowSize);
+
+    /**
+     * @brief Signal to noise ratio of a signal compared with a reference, in dB.
+     */
+    inline static double signalToNoise(const univector<float>& reference, const univector<float>& signal);
+
+    /**
+     * @brief Mean log-spectral distance of a signal from a reference over the frames where the reference is not silent, in dB.
+     */
+    inline double spectralDistance(const univector<float>& reference, const univector<float>& signal);
+
+    /**
+     * @brief Renders the fixtures with the reference engine of each voicing and compares them with the golden outputs
+     * in the directory.
+     *
+     * @param directory Holds one file of raw 32-bit floats per fixture, voicing and window size.
+     * @param windowSize The analysis window.
+     * @param references Receives the golden output of each voicing and fixture, or the rendered output where there is
+     * none. Indexed by voicing, then fixture.
+     *
+     * @return False if a golden output is missing or differs from the rendered one by more than goldenTolerance.
+     */
+    inline bool checkGolden(const juce::File& directory, LPCeffect::WindowSizeEnum windowSize,
+                            std::vector<univector<float>>& references);
+
+    /**
+     * @brief Renders the fixtures with the reference engine of each voicing and stores them as the golden outputs.
+     *
+     * @return False if a file could not be written.
+     */
+    inline bool writeGolden(const juce::File& directory, LPCeffect::WindowSizeEnum windowSize) const;
+
+    static constexpr int sampleRate = 44100;
+    // smallest signal to noise ratio to the golden output, leaves room for a different compiler or FFT kernels
+    static constexpr double goldenTolerance = 60.0;
+
+private:
+    [[nodiscard]] inline juce::File goldenFile(const juce::File& directory, const Fixture& fixture,
+                                               const Voicing& voicing, LPCeffect::WindowSizeEnum windowSize) const;
+
+    static constexpr int spectrumSize = 2048;
+
+    std::vector<Fixture> fixtures;
+    dft_plan_real<float> spectrumPlan{spectrumSize};
+    univector<u8> spectrumTemp;
+};
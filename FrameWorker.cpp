@@ -0,0 +1,97 @@
+#include "FrameWorker.h"
+#include "AllocationTracker.h"
+#if !defined(_WIN32)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+bool FrameJob::tryClaim() {
+    auto expected = State::Queued;
+    return state.compare_exchange_strong(expected, State::Running, std::memory_order_acquire);
+}
+
+void FrameJob::finish() {
+    state.store(State::Done, std::memory_order_release);
+}
+
+bool FrameJob::complete() {
+    const bool late = state.load(std::memory_order_acquire) != State::Done;
+    if (!tryComplete()) {
+        // mid-job elsewhere, finishing it is cheaper than starting over
+        while (state.load(std::memory_order_acquire) != State::Done)
+            std::this_thread::yield();
+        state.store(State::Idle, std::memory_order_relaxed);
+    }
+    return late;
+}
+
+bool FrameJob::tryComplete() {
+    if (tryClaim()) {
+        render();
+        finish();
+    }
+    else if (state.load(std::memory_order_acquire) != State::Done) {
+        return false;
+    }
+    state.store(State::Idle, std::memory_order_relaxed);
+    return true;
+}
+
+FrameWorker::~FrameWorker() {
+    stop();
+}
+
+void FrameWorker::addQueue(Queue* queue) {
+    jassert(!running.load());
+    queues.push_back(queue);
+}
+
+void FrameWorker::clearQueues() {
+    jassert(!running.load());
+    queues.clear();
+}
+
+void FrameWorker::start(bool realtimePriority) {
+    if (running.exchange(true))
+        return;
+    thread = std::thread([this, realtimePriority] { run(realtimePriority); });
+}
+
+void FrameWorker::stop() {
+    if (!running.exchange(false))
+        return;
+    notify();
+    thread.join();
+}
+
+void FrameWorker::notify() {
+    wakeups.fetch_add(1, std::memory_order_release);
+    wakeups.notify_one();
+}
+
+void FrameWorker::run(bool realtimePriority) {
+#if !defined(_WIN32)
+    if (realtimePriority) {
+        sched_param param{};
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+    }
+#endif
+    juce::ignoreUnused(realtimePriority);
+    juce::ScopedNoDenormals noDenormals;
+    while (running.load(std::memory_order_acquire)) {
+        const auto seen = wakeups.load(std::memory_order_acquire);
+        for (auto* queue : queues) {
+            FrameJob* job;
+            while (queue->pop(job)) {
+                // jobs already taken over by the audio thread are skipped
+                if (job->tryClaim()) {
+                    ScopedNoAllocation noAllocation;
+                    job->render();
+                    job->finish();
+                }
+            }
+        }
+        wakeups.wait(seen, std::memory_order_acquire);
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Bounded lock-free single-producer single-consumer queue.
+ *
+ * @tparam T Trivially copyable element type.
+ * @tparam Capacity Number of slots, must be a power of two.
+ */
+template <typename T, int Capacity>
+class SpscQueue {
+public:
+    static_assert((Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+    bool push(const T& item) {
+        const auto tail = writePos.load(std::memory_order_relaxed);
+        if (tail - readPos.load(std::memory_order_acquire) == Capacity)
+            return false;
+        slots[tail & (Capacity - 1)] = item;
+        writePos.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T& item) {
+        const auto head = readPos.load(std::memory_order_relaxed);
+        if (head == writePos.load(std::memory_order_acquire))
+            return false;
+        item = slots[head & (Capacity - 1)];
+        readPos.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    std::array<T, Capacity> slots{};
+    std::atomic<unsigned int> writePos{0};
+    std::atomic<unsigned int> readPos{0};
+};
+
+/**
+ * @brief A frame of work that can be rendered either by the FrameWorker or, as a fallback, by the audio thread.
+ *
+ * Whoever moves the job from Queued to Running owns it until it is marked Done.
+ */
+class FrameJob {
+public:
+    enum class State {
+        Idle, Queued, Running, Done
+    };
+
+    virtual ~FrameJob() = default;
+
+    /**
+     * @brief Renders the frame. Called by whichever thread claimed the job.
+     */
+    virtual void render() = 0;
+
+    inline bool tryClaim();
+    inline void finish();
+
+    /**
+     * @brief Makes sure a queued job is done: renders it on the calling thread if nobody has claimed it yet,
+     * otherwise waits for the thread rendering it. Leaves the job Idle.
+     *
+     * @return True if the job was not done yet when called.
+     */
+    inline bool complete();
+
+    /**
+     * @brief Like complete, but does not wait for another thread that is mid-job.
+     *
+     * @return False if the job is still being rendered elsewhere, it is then left as it is.
+     */
+    inline bool tryComplete();
+
+    std::atomic<State> state{State::Idle};
+};
+
+/**
+ * @brief Background thread rendering frames handed over by the effect instances.
+ *
+ * Every instance owns its own SPSC queue, so the audio side never contends with another producer.
+ * Queues are registered while the worker is stopped.
+ */
+class FrameWorker {
+public:
+    using Queue = SpscQueue<FrameJob*, 8>;
+
+    FrameWorker() = default;
+    inline ~FrameWorker();
+
+    inline void addQueue(Queue* queue);
+    inline void clearQueues();
+
+    /**
+     * @brief Starts the worker thread.
+     *
+     * @param realtimePriority Asks for a real-time scheduling class, best effort: ignored where not permitted or supported.
+     */
+    inline void start(bool realtimePriority = false);
+    inline void stop();
+
+    /**
+     * @brief Wakes the worker after a job was pushed. Lock-free, safe to call from the audio thread.
+     */
+    inline void notify();
+
+private:
+    inline void run(bool realtimePriority);
+
+    std::vector<Queue*> queues;
+    std::thread thread;
+    std::atomic<bool> running{false};
+    std::atomic<unsigned int> wakeups{0};
+};
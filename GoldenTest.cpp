@@ -0,0 +1,32 @@
+// Regression test of the reference engine: renders the engine fixtures with each analysis window and compares them
+// with the golden outputs committed in golden/. Run by ctest; --update rewrites the golden outputs after an intended
+// change of the sound.
+//
+// prescient-golden-test <directory> [--update]
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <cstdio>
+#include "LPCeffect.cpp"
+#include "EngineFixtures.cpp"
+
+int main(int argc, char* argv[]) {
+    const bool update = argc == 3 && juce::String(argv[2]) == "--update";
+    if (argc != 2 && !update) {
+        std::fprintf(stderr, "usage: prescient-golden-test <directory> [--update]\n");
+        return 1;
+    }
+    const auto directory = juce::File::getCurrentWorkingDirectory().getChildFile(argv[1]);
+
+    juce::ScopedNoDenormals noDenormals;
+    EngineFixtures fixtures;
+    // every analysis window, their frame lengths and hops take different paths through the effect
+    bool passed = true;
+    for (auto windowSize : {LPCeffect::WindowSizeEnum::S, LPCeffect::WindowSizeEnum::M, LPCeffect::WindowSizeEnum::L}) {
+        if (update) {
+            passed = fixtures.writeGolden(directory, windowSize) && passed;
+            continue;
+        }
+        std::vector<univector<float>> references;
+        passed = fixtures.checkGolden(directory, windowSize, references) && passed;
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+// Accuracy test of the DSP kernels and the phase vocoder's approximations against straightforward references in
+// double precision. Run by ctest.
+//
+// prescient-kernel-test
+#include <juce_audio_basics/juce_audio_basics.h>
+#include <cstdio>
+#include <random>
+#include "LPCeffect.cpp"
+
+class LPCkernelTest {
+public:
+    LPCkernelTest() : effect(44100) {
+        effect.prepare();
+    }
+
+    /**
+     * @brief Checks both paths of the lag-limited autocorrelation, the direct sums at the model orders the plugin
+     * allows and the zero-padded FFT at lag counts where it is chosen, against the linear autocorrelation.
+     *
+     * @return False if a lag is off by more than the tolerance, relative to lag 0.
+     */
+    bool autocorrelation() {
+        std::mt19937 generator(5);
+        std::uniform_real_distribution<float> noise(-1.f, 1.f);
+        bool passed = true;
+        for (auto size : {LPCeffect::WindowSizeEnum::S, LPCeffect::WindowSizeEnum::M, LPCeffect::WindowSizeEnum::L}) {
+            effect.setWindowSize(size);
+            const int length = effect.windowSize;
+            // a sinusoid over noise, so that the high lags are far from zero
+            univector<float> frame(length);
+            for (int n = 0; n < length; ++n)
+                frame[n] = 0.6f * std::sin(0.07f * static_cast<float>(n)) + 0.2f * noise(generator);
+
+            // the direct path up to the largest order, the FFT path at a lag count where it is the cheaper one
+            for (int numLags : {LPCeffect::maxModelOrder + 1, 384}) {
+                const bool fft = effect.prefersFFTautocorrelation(numLags);
+                if (fft != (numLags > LPCeffect::maxModelOrder + 1)) {
+                    std::fprintf(stderr, "autocorrelation/%d with %d lags does not take the expected path\n", length, numLags);
+                    passed = false;
+                }
+                univector<float> lags(numLags);
+                effect.autocorrelation(frame, lags, numLags);
+                double reference0 = 0.0;
+                double error = 0.0;
+                for (int lag = 0; lag < numLags; ++lag) {
+                    double reference = 0.0;
+                    for (int n = 0; n + lag < length; ++n)
+                        reference += static_cast<double>(frame[n]) * frame[n + lag];
+                    if (lag == 0)
+                        reference0 = reference;
+                    error = std::max(error, std::abs(lags[lag] - reference));
+                }
+                const double relative = error / reference0;
+                const bool matches = relative <= autocorrelationTolerance;
+                std::fprintf(stderr, "autocorrelation/%-5d %-6s %3d lags  max error %.2e of lag 0 %s\n", length,
+                             fft ? "fft" : "direct", numLags, relative, matches ? "ok" : "FAILED");
+                passed = passed && matches;
+            }
+        }
+        return passed;
+    }
+
+    /**
+     * @brief Checks the phase vocoder's approximations against the standard functions: atan2 over every angle at
+     * magnitudes across the float range, sin and cos over phases of several periods either side of 0.
+     *
+     * @return False if an approximation is off by more than its documented error.
+     */
+    bool approximations() {
+        constexpr int numAngles = 1 << 20;
+        double atan2Error = 0.0;
+        for (double radius : {1e-30, 1e-6, 1.0, 1e6, 1e30})
+            for (int i = 0; i <= numAngles; ++i) {
+                const double angle = -phaseVocoderKernels::pi + 2.0 * phaseVocoderKernels::pi * i / numAngles;
+                const auto x = static_cast<float>(radius * std::cos(angle));
+                const auto y = static_cast<float>(radius * std::sin(angle));
+                const double reference = std::atan2(static_cast<double>(y), static_cast<double>(x));
+                atan2Error = std::max(atan2Error, std::abs(phaseVocoderKernels::atan2Approx(y, x) - reference));
+            }
+        // the quadrant selects and the sign of 0
+        for (auto [y, x] : {std::pair{0.f, 0.f}, {0.f, 1.f}, {1.f, 0.f}, {0.f, -1.f}, {-1.f, 0.f}, {-0.f, -1.f}}) {
+            const double reference = std::atan2(static_cast<double>(y), static_cast<double>(x));
+            atan2Error = std::max(atan2Error, std::abs(phaseVocoderKernels::atan2Approx(y, x) - reference));
+        }
+
+        double sineError = 0.0;
+        double cosineError = 0.0;
+        constexpr double range = 16.0 * phaseVocoderKernels::pi;
+        for (int i = 0; i <= numAngles; ++i) {
+            const auto phase = static_cast<float>(-range + 2.0 * range * i / numAngles);
+            float sine, cosine;
+            phaseVocoderKernels::sinCosApprox(phase, sine, cosine);
+            sineError = std::max(sineError, std::abs(sine - std::sin(static_cast<double>(phase))));
+            cosineError = std::max(cosineError, std::abs(cosine - std::cos(static_cast<double>(phase))));
+        }
+
+        bool passed = true;
+        auto report = [&passed](const char* name, double error, double tolerance) {
+            std::fprintf(stderr, "%-28s max error %.2e %s\n", name, error, error <= tolerance ? "ok" : "FAILED");
+            passed = passed && error <= tolerance;
+        };
+        report("atan2Approx", atan2Error, atan2Tolerance);
+        report("sinCosApprox/sin", sineError, sinCosTolerance);
+        report("sinCosApprox/cos", cosineError, sinCosTolerance);
+        return passed;
+    }
+
+private:
+    // the errors PhaseVocoderKernels.h documents
+    static constexpr double atan2Tolerance = 1.2e-5;
+    static constexpr double sinCosTolerance = 5e-7;
+    // float sums over a few thousand samples, and the rounding of the transforms
+    static constexpr double autocorrelationTolerance = 1e-5;
+
+    LPCeffect effect;
+};
+
+int main() {
+    juce::ScopedNoDenormals noDenormals;
+    LPCkernelTest test;
+    const bool autocorrelation = test.autocorrelation();
+    const bool approximations = test.approximations();
+    return autocorrelation && approximations ? 0 : 1;
+}
@@ -1,154 +1,805 @@
 #include "LPCeffect.h"
 #include <kfr/base.hpp>
 #include <kfr/dft.hpp>
+#include <cstring>
 using namespace kfr;
 using namespace std::chrono;
 
 // constructor
 LPCeffect::LPCeffect(const int sampleRate) {
-    shiftEffect = new ShiftEffect(sampleRate);
-    windowSize = 2048;
+    shiftEffect = std::make_unique<ShiftEffect>(sampleRate);
     windowSizeEnum = WindowSizeEnum::M;
+    overlapEnum = OverlapEnum::Half;
+    frameTask.owner = this;
+}
+
+void LPCeffect::prepare() {
+    // a frame in flight still uses the buffers reserved below
+    cancelFrame(frameTask);
+    // plans for every window size and storage for the largest, so that switching does not allocate
+    const int maxWindowSize = static_cast<int>(hannWindowL.size());
+    size_t dftTempSize = 0;
+    size_t paddedTempSize = 0;
+    for (auto size : {WindowSizeEnum::S, WindowSizeEnum::M, WindowSizeEnum::L}) {
+        const auto i = static_cast<size_t>(size);
+        const auto length = hannWindow[size].size();
+        dftPlans[i] = std::make_unique<dft_plan_real<float>>(length);
+        paddedPlans[i] = std::make_unique<dft_plan_real<float>>(2 * length);
+        dftTempSize = std::max(dftTempSize, dftPlans[i]->temp_size);
+        paddedTempSize = std::max(paddedTempSize, paddedPlans[i]->temp_size);
+    }
+    dftTemp.resize(dftTempSize);
+    paddedTemp.resize(paddedTempSize);
+
+    // the rings hold a window, the hop an offloaded frame stays in flight and another hop for a late one to stop,
+    // twice for contiguous frames
+    const int maxRingSize = maxWindowSize + maxWindowSize;
+    carrierRing.resize(2 * maxRingSize);
+    voiceRing.resize(2 * maxRingSize);
+    for (auto* buffer : {&outputAccumulator, &frameTask.output, &previousOutput, &frameResult, &carrierResiduals, &synthesized,
+                         &paddedCoeff, &synthesisWindow, &burgForward, &burgBackward})
+        buffer->reserve(maxWindowSize);
+    paddedSignal.reserve(2 * maxWindowSize);
+    spectrum.reserve(maxWindowSize / 2 + 1);
+    coeffSpectrum.reserve(maxWindowSize / 2 + 1);
+    paddedSpectrum.reserve(maxWindowSize + 1);
+    correlation.resize(maxModelOrder + 1);
+
+    // working storage for every frame, so that processing does not allocate
+    voiceLPC.reserve(maxModelOrder + 1);
+    carrierLPC.reserve(maxModelOrder + 1);
+    voiceReflection.resize(maxModelOrder);
+    carrierReflection.resize(maxModelOrder);
+    previousReflection.resize(maxModelOrder, 0.f);
+    latticeState.resize(maxModelOrder + 1);
+    shiftEffect -> prepare(maxWindowSize);
+    configureWindow();
+}
+
+void LPCeffect::setWindowSize(WindowSizeEnum size) {
+    if (size == windowSizeEnum)
+        return;
+    cancelFrame(frameTask);
+    windowSizeEnum = size;
+    configureWindow();
+}
+
+void LPCeffect::setOverlap(OverlapEnum newOverlap) {
+    if (newOverlap == overlapEnum)
+        return;
+    cancelFrame(frameTask);
+    overlapEnum = newOverlap;
+    configureWindow();
+}
+
+void LPCeffect::configureWindow() {
+    windowSize = static_cast<int>(hannWindow[windowSizeEnum].size());
     jassert(windowSize % 2 == 0); // real-to-complex and complex-to-real transforms are only available for even sizes
+    switch (overlapEnum) {
+        case OverlapEnum::Half:
+            overlap = 0.5f;
+            break;
+        case OverlapEnum::ThreeQuarters:
+            overlap = 0.75f;
+            break;
+        case OverlapEnum::SevenEighths:
+            overlap = 0.875f;
+            break;
+    }
     overlapSize = round(windowSize * overlap);
     hopSize = windowSize - overlapSize;
+    ringSize = windowSize + 2 * hopSize;
+    // the overlapped Hann windows sum to windowSize / (2 * hopSize), scaled back to the level of 50% overlap
+    overlapGain = 2.f * static_cast<float>(hopSize) / static_cast<float>(windowSize);
+
+    // within the capacity reserved in prepare
+    for (auto* buffer : {&frameResult, &carrierResiduals, &synthesized, &paddedCoeff, &synthesisWindow, &frameTask.output,
+                         &previousOutput, &burgForward, &burgBackward})
+        buffer->resize(windowSize);
+    outputAccumulator.resize(windowSize);
+    paddedSignal.resize(2 * windowSize);
+    spectrum.resize(windowSize / 2 + 1);
+    coeffSpectrum.resize(windowSize / 2 + 1);
+    paddedSpectrum.resize(windowSize + 1);
+
+    const auto& window = hannWindow[windowSizeEnum];
+    std::copy(window.begin(), window.end(), synthesisWindow.begin());
+    dftPlan = dftPlans[static_cast<size_t>(windowSizeEnum)].get();
+    paddedPlan = paddedPlans[static_cast<size_t>(windowSizeEnum)].get();
+    std::fill(previousReflection.begin(), previousReflection.end(), 0.f);
+    restartBuffers();
+
+    // the shifter's grains scale with the analysis window
+    switch (windowSizeEnum) {
+        case WindowSizeEnum::S:
+            shiftEffect -> setWindowLength(ShiftEffect::WindowLenEnum::S);
+            break;
+        case WindowSizeEnum::M:
+            shiftEffect -> setWindowLength(ShiftEffect::WindowLenEnum::M);
+            break;
+        case WindowSizeEnum::L:
+            shiftEffect -> setWindowLength(ShiftEffect::WindowLenEnum::L);
+            break;
+    }
+}
+
+void LPCeffect::restartBuffers() {
+    // a frame in flight belongs to the old buffers: it is stopped, so that no thread writes to them, and dropped
+    cancelFrame(frameTask);
+    stagedElapsed = 0;
+    // the first frame is due once the ring holds a whole window
+    ringPos = 0;
+    samplesToFrame = windowSize;
+    voiceEnvelope.modelOrder = 0;
+    carrierEnvelope.modelOrder = 0;
+    accumulatorPos = 0;
+    std::fill(outputAccumulator.begin(), outputAccumulator.end(), 0.f);
+    std::fill(previousOutput.begin(), previousOutput.end(), 0.f);
+}
+
+void LPCeffect::attachWorker(FrameWorker& worker) {
+    frameWorker = &worker;
+    frameWorker->addQueue(&jobQueue);
+}
+
+void LPCeffect::setFollowers(std::vector<LPCeffect*> effects) {
+    followers = std::move(effects);
+}
 
-    carrierBuffer1.resize(windowSize);
-    carrierBuffer2.resize(windowSize);
-    sideChainBuffer1.resize(windowSize);
-    sideChainBuffer2.resize(windowSize);
-    filteredBuffer1.resize(windowSize, 0.f);
-    filteredBuffer2.resize(windowSize, 0.f);
+void LPCeffect::setLinked(bool isLinked) {
+    if (isLinked == linked)
+        return;
+    // a linked frame in flight writes the followers' outputs, and a follower's own frame in flight its shift effect
+    // and result: both are stopped, and a staged one retired, before the channels switch
+    cancelFrame(frameTask);
+    for (auto* follower : followers)
+        follower->cancelFrame(follower->frameTask);
+    linked = isLinked;
+    restartBuffers();
+    for (auto* follower : followers)
+        follower->restartBuffers();
+}
+
+void LPCeffect::setProcessingMode(ProcessingMode mode) {
+    if (mode == processingMode)
+        return;
+    cancelFrame(frameTask);
+    processingMode = mode;
+    restartBuffers();
 }
 
-// add received samples to buffers, process once buffer full
 float LPCeffect::sendSample(float carrierSample, float voiceSample, float modelOrder, float shiftVoice1,
                             float shiftVoice2, float shiftVoice3, bool enableLPC, float passthrough) {
-    carrierBuffer1[index1] = carrierSample;
-    sideChainBuffer1[index1] = voiceSample;
-    if (index2 >= hopSize & overlap != 0) {
-        carrierBuffer2[index2 - hopSize] = carrierSample;
-        sideChainBuffer2[index2 - hopSize] = voiceSample;
-    }
-    ++index1;
-    ++index2;
-    if (index1 == windowSize) {
-        index1 = 0;
-        processing(filteredBuffer1, sideChainBuffer1, carrierBuffer1, shiftVoice1, shiftVoice2, shiftVoice3, enableLPC, passthrough);
-        frameModelOrder = static_cast<int>(modelOrder);
-    }
-    else if (index2 == hopSize + windowSize && overlap != 0) {
-        index2 = hopSize;
-        processing(filteredBuffer2, sideChainBuffer2, carrierBuffer2, shiftVoice1, shiftVoice2, shiftVoice3, enableLPC, passthrough);
-    }
-    float output = filteredBuffer1[index1];
-    if (index2 >= hopSize & overlap != 0)
-        output += filteredBuffer2[index2 - hopSize];
+    float output;
+    processBlock(&carrierSample, &voiceSample, &output, 1,
+                 {static_cast<int>(modelOrder), shiftVoice1, shiftVoice2, shiftVoice3, enableLPC, passthrough});
     return output;
 }
 
-void LPCeffect::processing(univector<float>& toOverwrite, const univector<float>& voice, const univector<float>& carrier,
-                           float shiftVoice1,  float shiftVoice2, float shiftVoice3, bool enableLPC, float passthrough) {
-    univector<float> result = voice;
+void LPCeffect::processBlock(const float* carrier, const float* voice, float* out, int numSamples, const Params& params) {
+    jassert(!linked);
+    processChannels(&carrier, &voice, &out, 0, numSamples, params);
+}
+
+void LPCeffect::processLinkedBlock(const float* const* carriers, const float* const* voices, float* const* outs,
+                                   int numChannels, int numSamples, const Params& params) {
+    jassert(linked && numChannels >= 1 && numChannels <= static_cast<int>(followers.size()) + 1);
+    processChannels(carriers, voices, outs, numChannels - 1, numSamples, params);
+}
+
+// add received samples to the rings, process a frame every hop
+void LPCeffect::processChannels(const float* const* carriers, const float* const* voices, float* const* outs,
+                                int numLinked, int numSamples, const Params& params) {
+    for (int done = 0; done < numSamples;) {
+        // run up to the next frame boundary, the linked channels are in step with this one
+        const int length = std::min(numSamples - done, samplesToFrame);
+        for (int channel = 0; channel <= numLinked; ++channel) {
+            auto* effect = linkedChannel(channel);
+            effect->writeInput(carriers[channel] + done, voices[channel] + done, length);
+            // only the last sample of the run can complete a frame, the others are read before it is processed
+            effect->readOutput(outs[channel] + done, length - 1);
+        }
+        samplesToFrame -= length;
+        if (stagedTask != nullptr)
+            advanceAmortized(length);
+        if (samplesToFrame == 0) {
+            frameBoundary(numLinked, params);
+            samplesToFrame = hopSize;
+        }
+        for (int channel = 0; channel <= numLinked; ++channel)
+            linkedChannel(channel)->readOutput(outs[channel] + done + length - 1, 1);
+        done += length;
+    }
+}
+
+void LPCeffect::writeInput(const float* carrier, const float* voice, int numSamples) {
+    for (int done = 0; done < numSamples;) {
+        const int length = std::min(numSamples - done, ringSize - ringPos);
+        // every sample is kept twice, one ring apart, so that the latest window is always contiguous
+        for (int copy : {ringPos, ringPos + ringSize}) {
+            std::copy(carrier + done, carrier + done + length, carrierRing.begin() + copy);
+            std::copy(voice + done, voice + done + length, voiceRing.begin() + copy);
+        }
+        done += length;
+        ringPos = (ringPos + length) % ringSize;
+    }
+}
+
+void LPCeffect::frameBoundary(int numLinked, const Params& params) {
+    const int frameStart = ringPos + ringSize - windowSize;
+    if (processingMode == ProcessingMode::Realtime) {
+        frameTask.frameStart = frameStart;
+        frameTask.numLinked = numLinked;
+        frameTask.params = params;
+        processing(frameTask);
+        overlapFrame(frameTask);
+        return;
+    }
+    // the frame submitted one hop ago is due now, a late one is replaced by the previous frame
+    if (collectFrame(frameTask))
+        overlapFrame(frameTask);
+    else
+        repeatFrame(frameTask);
+    // while a late frame is still stopping, this one is skipped
+    if (frameTask.state.load(std::memory_order_acquire) == FrameJob::State::Idle)
+        submitFrame(frameTask, frameStart, numLinked, params);
+}
+
+void LPCeffect::overlapFrame(const FrameTask& task) {
+    for (int channel = 0; channel <= task.numLinked; ++channel) {
+        auto* effect = linkedChannel(channel);
+        effect->overlapAdd(effect->frameTask.output);
+        // kept for a late frame, the next one is written to the other buffer
+        std::swap(effect->frameTask.output, effect->previousOutput);
+    }
+}
+
+void LPCeffect::repeatFrame(const FrameTask& task) {
+    for (int channel = 0; channel <= task.numLinked; ++channel) {
+        auto* effect = linkedChannel(channel);
+        effect->overlapAdd(effect->previousOutput);
+    }
+}
+
+void LPCeffect::overlapAdd(const univector<float>& frame) {
+    // the frame covers the next windowSize output samples, starting with the one read next
+    const int first = windowSize - accumulatorPos;
+    const float gain = overlapGain;
+    std::transform(frame.begin(), frame.begin() + first, outputAccumulator.begin() + accumulatorPos,
+                   outputAccumulator.begin() + accumulatorPos, [gain](float x, float sum) {
+        return sum + x * gain;
+    });
+    std::transform(frame.begin() + first, frame.end(), outputAccumulator.begin(), outputAccumulator.begin(),
+                   [gain](float x, float sum) {
+        return sum + x * gain;
+    });
+}
+
+void LPCeffect::readOutput(float* out, int numSamples) {
+    for (int done = 0; done < numSamples;) {
+        const int length = std::min(numSamples - done, windowSize - accumulatorPos);
+        const auto from = outputAccumulator.begin() + accumulatorPos;
+        std::copy(from, from + length, out + done);
+        std::fill(from, from + length, 0.f);
+        done += length;
+        accumulatorPos = (accumulatorPos + length) % windowSize;
+    }
+}
 
-    if (shiftVoice1 >= 1.01 || shiftVoice1 <= 0.99)
-        result = shiftEffect -> shiftSignal(result, shiftVoice1);
-    if (shiftVoice2 >= 1.01 || shiftVoice2 <= 0.99)
-        result += shiftEffect -> shiftSignal(voice, shiftVoice2);
-    if (shiftVoice3 >= 1.01  || shiftVoice3 <= 0.99)
-        result += shiftEffect -> shiftSignal(voice, shiftVoice3);
-    matchPower(result, voice);
+void LPCeffect::submitFrame(FrameTask& task, int frameStart, int numLinked, const Params& params) {
+    // the frame stays in the rings until it is collected one hop later, no copy needed
+    task.frameStart = frameStart;
+    task.numLinked = numLinked;
+    task.params = params;
+    task.state.store(FrameJob::State::Queued, std::memory_order_release);
 
-    if (enableLPC) {
-        result = processLPC(result, carrier);
-        matchPower(result, voice);
+    if (processingMode == ProcessingMode::Amortized) {
+        task.tryClaim();
+        beginProcessing(task);
+        stagedTask = &task;
+        stagedElapsed = 0;
+        return;
     }
+    if (frameWorker != nullptr && jobQueue.push(&task)) {
+        frameWorker->notify();
+        return;
+    }
+    // no worker or queue full: keep the timing, render now
+    task.tryClaim();
+    task.render();
+    task.finish();
+}
 
-    result = mul(result, passthrough) + mul(voice, 1 - passthrough);
+bool LPCeffect::collectFrame(FrameTask& task) {
+    if (task.state.load(std::memory_order_acquire) == FrameJob::State::Idle)
+        return false;
 
-    std::memcpy(toOverwrite.data(), result.data(), result.size() * sizeof(float));
+    if (stagedTask == &task) {
+        while (processStep());
+        task.finish();
+        stagedTask = nullptr;
+    }
+
+    // cancelled at the previous boundary: the worker stopped after the step it was in, unless it was preempted for
+    // the whole hop since, which is waited out
+    if (task.cancelled.load(std::memory_order_relaxed)) {
+        task.complete();
+        task.cancelled.store(false, std::memory_order_relaxed);
+        return false;
+    }
+    // the worker has not finished the frame in time: process it here if it has not started, otherwise cancel it
+    const bool late = task.state.load(std::memory_order_acquire) != FrameJob::State::Done;
+    if (late)
+        deadlineMisses.fetch_add(1, std::memory_order_relaxed);
+    if (task.tryComplete())
+        return true;
+    if (waitForLateFrames) {
+        task.complete();
+        return true;
+    }
+    task.cancelled.store(true, std::memory_order_relaxed);
+    return false;
 }
 
-univector<float> LPCeffect::processLPC(const univector<float>& voice, const univector<float>& carrier) {
-    univector<float> LPCvoice = levinsonDurbin(autocorrelation(voice));
-    return FFToperations(FFToperation::IIR, getResiduals(carrier), LPCvoice);
+void LPCeffect::cancelFrame(FrameTask& task) {
+    if (task.state.load(std::memory_order_acquire) == FrameJob::State::Idle)
+        return;
+    // a staged frame is this thread's, one not started yet is dropped as it is
+    if (stagedTask == &task) {
+        task.finish();
+        stagedTask = nullptr;
+    }
+    else if (task.tryClaim()) {
+        task.finish();
+    }
+    task.cancelled.store(true, std::memory_order_relaxed);
+    task.complete();
+    task.cancelled.store(false, std::memory_order_relaxed);
 }
 
-univector<float> LPCeffect::FFToperations(FFToperation o, const univector<float>& inputBuffer, const univector<float>& coefficients) {
-    univector<float> paddedCoeff(windowSize);
+void LPCeffect::processing(FrameTask& task) {
+    beginProcessing(task);
+    // a cancelled frame stops after the step in progress
+    while (!task.cancelled.load(std::memory_order_relaxed) && processStep());
+}
+
+void LPCeffect::beginProcessing(FrameTask& task) {
+    linkedProgress = {task.numLinked, 0, 0, 0};
+    const auto frameBytes = static_cast<size_t>(windowSize) * sizeof(float);
+    for (int channel = 0; channel <= task.numLinked; ++channel) {
+        auto* effect = linkedChannel(channel);
+        const std::span<const float> voice(effect->voiceRing.data() + task.frameStart, windowSize);
+        const std::span<const float> carrier(effect->carrierRing.data() + task.frameStart, windowSize);
+
+        // the first earlier channel with the same voice or carrier, e.g. a mono sidechain routed to every channel
+        const LPCeffect* voiceSource = nullptr;
+        const LPCeffect* carrierSource = nullptr;
+        for (int earlier = 0; earlier < channel; ++earlier) {
+            const auto* other = linkedChannel(earlier);
+            // gated channels have no analysis to share
+            if (other->progress.silent)
+                continue;
+            if (voiceSource == nullptr && std::memcmp(voice.data(), other->progress.voice.data(), frameBytes) == 0)
+                voiceSource = other;
+            if (carrierSource == nullptr && std::memcmp(carrier.data(), other->progress.carrier.data(), frameBytes) == 0)
+                carrierSource = other;
+        }
+        effect->beginChannel(effect->frameTask.output, voice, carrier, task.params, voiceSource, carrierSource);
+        linkedProgress.stepsTotal += effect->progress.stepsTotal;
+    }
+}
+
+bool LPCeffect::processStep() {
+    if (linkedProgress.channel > linkedProgress.numLinked)
+        return false;
+    ++linkedProgress.stepsDone;
+    if (linkedChannel(linkedProgress.channel)->channelStep())
+        return true;
+    return ++linkedProgress.channel <= linkedProgress.numLinked;
+}
+
+void LPCeffect::beginChannel(univector<float>& toOverwrite, std::span<const float> voice, std::span<const float> carrier,
+                             const Params& params, const LPCeffect* voiceSource, const LPCeffect* carrierSource) {
+    frameModelOrder = std::clamp(params.modelOrder, 1, maxModelOrder);
+    progress.output = &toOverwrite;
+    progress.voice = voice;
+    progress.carrier = carrier;
+    progress.params = params;
+    progress.stage = Stage::ShiftVoices;
+    progress.shifting = false;
+    progress.voiceSource = voiceSource;
+    progress.carrierSource = carrierSource;
+
+    // voices close to the original pitch are left out, 0 tells the shifter so
+    progress.shifts = {params.shiftVoice1, params.shiftVoice2, params.shiftVoice3};
+    for (float& shift : progress.shifts)
+        if (shift < 1.01 && shift > 0.99)
+            shift = 0.f;
+
+    // nothing to shape: the wet signal would be silent, only the dry one is written
+    progress.silent = isSilent(voice) || (params.enableLPC && isSilent(carrier));
+    if (progress.silent) {
+        progress.stepsTotal = 1;
+        return;
+    }
+    // one step per grain, per LPC stage and per stage transition; reused work takes a step to copy
+    if (voiceSource != nullptr && voiceSource == carrierSource) {
+        progress.stepsTotal = 1;
+        return;
+    }
+    if (voiceSource != nullptr) {
+        progress.stepsTotal = params.enableLPC ? 4 : 2;
+        return;
+    }
+    std::copy(voice.begin(), voice.end(), frameResult.begin());
+    progress.stepsTotal = 2 + std::max(1, shiftEffect -> grainCount(static_cast<int>(voice.size()), progress.shifts));
+    if (params.enableLPC)
+        progress.stepsTotal += 3;
+}
+
+bool LPCeffect::channelStep() {
+    const std::span<const float> voice = progress.voice;
+    const Params& params = progress.params;
+    const Stage stage = progress.stage;
+    const auto stepStart = StageTelemetry::start();
+
+    switch (progress.stage) {
+        case Stage::ShiftVoices: {
+            if (progress.silent) {
+                skipSilentFrame();
+                break;
+            }
+            if (progress.voiceSource != nullptr) {
+                reuseVoiceAnalysis();
+                break;
+            }
+            if (std::all_of(progress.shifts.begin(), progress.shifts.end(), [](float shift) { return shift == 0.f; })) {
+                progress.stage = Stage::MatchShifted;
+                break;
+            }
+            if (!progress.shifting) {
+                // all voices in one pass, they share the grain analysis
+                shiftEffect -> beginShift(voice, progress.shifts);
+                progress.shifting = true;
+            }
+            if (shiftEffect -> shiftGrains(1)) {
+                // the first voice replaces the dry signal, the others are added
+                if (progress.shifts[0] > 0.f)
+                    shiftEffect -> copyShifted(frameResult);
+                else
+                    shiftEffect -> addShifted(frameResult);
+                progress.shifting = false;
+                progress.stage = Stage::MatchShifted;
+            }
+            break;
+        }
+        case Stage::MatchShifted:
+            matchPower(frameResult, voice);
+            progress.stage = params.enableLPC ? Stage::VoiceAnalysis : Stage::Mix;
+            break;
+        case Stage::VoiceAnalysis:
+            if (updateEnvelope(frameResult, voiceEnvelope, voiceLPC, voiceReflection, params.envelopeReuse))
+                reusedVoiceEnvelopes.fetch_add(1, std::memory_order_relaxed);
+            progress.stage = Stage::CarrierResiduals;
+            break;
+        case Stage::CarrierResiduals:
+            if (progress.carrierSource != nullptr)
+                std::copy(progress.carrierSource->carrierResiduals.begin(), progress.carrierSource->carrierResiduals.end(),
+                          carrierResiduals.begin());
+            else
+                getResiduals(progress.carrier, carrierResiduals);
+            progress.stage = Stage::Synthesis;
+            break;
+        case Stage::Synthesis:
+            // the shifted voice and the residuals are kept for linked channels that reuse them
+            if (params.synthesis == SynthesisEngine::Lattice)
+                latticeSynthesis(carrierResiduals, synthesized);
+            else
+                FFToperations(FFToperation::IIR, carrierResiduals, voiceLPC, synthesized);
+            matchPower(synthesized, voice);
+            progress.stage = Stage::Mix;
+            break;
+        case Stage::Mix: {
+            const auto& wetSignal = params.enableLPC ? synthesized : frameResult;
+            std::transform(wetSignal.begin(), wetSignal.end(), voice.begin(), progress.output->begin(),
+                           [&](float wet, float dry) {
+                               return wet * params.passthrough + dry * (1 - params.passthrough);
+                           });
+            progress.stage = Stage::Done;
+            break;
+        }
+        case Stage::Done:
+            return false;
+    }
+    // the stages and their probes are in the same order; gated and shared frames count as shifting
+    static_assert(static_cast<int>(Stage::Mix) == static_cast<int>(StageTelemetry::Probe::Mix));
+    telemetry.addStage(static_cast<StageTelemetry::Probe>(stage), stepStart);
+    if (progress.stage == Stage::Done)
+        telemetry.endFrame();
+    return progress.stage != Stage::Done;
+}
+
+bool LPCeffect::isSilent(std::span<const float> frame) {
+    return std::all_of(frame.begin(), frame.end(), [](float x) {
+        return std::abs(x) <= silenceThreshold;
+    });
+}
+
+void LPCeffect::skipSilentFrame() {
+    const float dryGain = 1 - progress.params.passthrough;
+    std::transform(progress.voice.begin(), progress.voice.end(), progress.output->begin(), [dryGain](float dry) {
+        return dry * dryGain;
+    });
+    // the next envelope is interpolated from the flat filter rather than from before the silence
+    std::fill(previousReflection.begin(), previousReflection.end(), 0.f);
+    voiceEnvelope.modelOrder = 0;
+    carrierEnvelope.modelOrder = 0;
+    silentFrames.fetch_add(1, std::memory_order_relaxed);
+    progress.stage = Stage::Done;
+}
+
+void LPCeffect::reuseVoiceAnalysis() {
+    const LPCeffect& source = *progress.voiceSource;
+    // the same inputs give the same output
+    if (progress.carrierSource == &source) {
+        std::copy(source.progress.output->begin(), source.progress.output->end(), progress.output->begin());
+        progress.stage = Stage::Done;
+        return;
+    }
+    std::copy(source.frameResult.begin(), source.frameResult.end(), frameResult.begin());
+    if (progress.params.enableLPC) {
+        // capacity is reserved in prepare, the resize does not allocate
+        voiceLPC.resize(source.voiceLPC.size());
+        std::copy(source.voiceLPC.begin(), source.voiceLPC.end(), voiceLPC.begin());
+        std::copy(source.voiceReflection.begin(), source.voiceReflection.end(), voiceReflection.begin());
+        // the predictor is no longer the one cached
+        voiceEnvelope.modelOrder = 0;
+        progress.stage = Stage::CarrierResiduals;
+    }
+    else {
+        progress.stage = Stage::Mix;
+    }
+}
+
+void LPCeffect::advanceAmortized(int samples) {
+    stagedElapsed += samples;
+    // spread the steps evenly so that the frame is finished by the end of the hop
+    const int total = linkedProgress.stepsTotal;
+    const int due = std::min(total, (total * stagedElapsed + hopSize - 1) / hopSize);
+    while (linkedProgress.stepsDone < due && processStep());
+}
+
+void LPCeffect::FFToperations(FFToperation o, std::span<const float> inputBuffer, const univector<float>& coefficients,
+                              univector<float>& output) {
+    std::fill(paddedCoeff.begin(), paddedCoeff.end(), 0.f);
     std::copy(coefficients.begin(), coefficients.end(), paddedCoeff.begin());
 
-    univector<std::complex<float>> fftInp = realdft(inputBuffer);
-    univector<std::complex<float>> fftCoeff = realdft(paddedCoeff);
+    dftPlan->execute(spectrum.data(), inputBuffer.data(), dftTemp.data());
+    dftPlan->execute(coeffSpectrum.data(), paddedCoeff.data(), dftTemp.data());
     switch (o) {
         case FFToperation::Convolution:
-            mulVectorWith(fftInp, fftCoeff);
-            return irealdft(fftInp);
+            mulVectorWith(spectrum, coeffSpectrum);
+            dftPlan->execute(output.data(), spectrum.data(), dftTemp.data());
+            break;
         case FFToperation::IIR:
-            divVectorWith(fftInp, fftCoeff);
-            univector<float> filtered = irealdft(fftInp);
-            mulVectorWith(filtered, hannWindow[windowSizeEnum]);
-            return filtered;
+            divVectorWith(spectrum, coeffSpectrum);
+            dftPlan->execute(output.data(), spectrum.data(), dftTemp.data());
+            mulVectorWith(output, synthesisWindow);
+            break;
     }
 }
 
-univector<float> LPCeffect::getResiduals(const univector<float>& ofBuffer) {
-    univector<float> LPC = levinsonDurbin(autocorrelation(ofBuffer));
-    return FFToperations(FFToperation::Convolution, ofBuffer, LPC);
+void LPCeffect::latticeSynthesis(const univector<float>& residuals, univector<float>& output) {
+    const int order = frameModelOrder;
+    const int length = static_cast<int>(residuals.size());
+    std::fill(latticeState.begin(), latticeState.begin() + order + 1, 0.f);
+
+    for (int n = 0; n < length; ++n) {
+        const float t = n < hopSize ? static_cast<float>(n) / static_cast<float>(hopSize) : 1.f;
+        // latticeState[i] holds the backward error of stage i from the previous sample
+        float forward = residuals[n];
+        for (int i = order; i >= 1; --i) {
+            const float k = previousReflection[i - 1] + t * (voiceReflection[i - 1] - previousReflection[i - 1]);
+            forward -= k * latticeState[i - 1];
+            latticeState[i] = latticeState[i - 1] + k * forward;
+        }
+        latticeState[0] = forward;
+        output[n] = forward;
+    }
+    std::copy(voiceReflection.begin(), voiceReflection.end(), previousReflection.begin());
+    mulVectorWith(output, synthesisWindow);
 }
 
-univector<float> LPCeffect::autocorrelation(const univector<float>& ofBuffer) {
-    // Wiener–Khinchin theorem
-    univector<std::complex<float>> fftBuffer = realdft(ofBuffer);
-    univector<std::complex<float>> fftBufferConj = cconj(fftBuffer);
-    mulVectorWith(fftBuffer, fftBufferConj);
-    univector<float> coeffs = irealdft(fftBuffer);
-    return coeffs;
+void LPCeffect::getResiduals(std::span<const float> ofBuffer, univector<float>& residuals) {
+    if (updateEnvelope(ofBuffer, carrierEnvelope, carrierLPC, carrierReflection, progress.params.envelopeReuse))
+        reusedCarrierEnvelopes.fetch_add(1, std::memory_order_relaxed);
+    FFToperations(FFToperation::Convolution, ofBuffer, carrierLPC, residuals);
 }
 
-univector<float> LPCeffect::levinsonDurbin(const univector<float>& corrCoeff) const {
-    std::vector<float> k(frameModelOrder + 1);
-    std::vector<float> E(frameModelOrder + 1);
-    // matrix of coefficients a[j][i] j = row, i = column
-    std::vector<std::vector<float>> a(frameModelOrder + 1, std::vector<float>(frameModelOrder + 1, 0.0f));
-    for (int r = 0; r <= frameModelOrder; ++r)
-        a[r][r] = 1;
+bool LPCeffect::updateEnvelope(std::span<const float> frame, EnvelopeCache& cache, univector<float>& LPCcoeffs,
+                               univector<float>& reflection, float threshold) {
+    constexpr int probeLags = EnvelopeCache::probeLags;
+    int firstLag = 0;
+    std::array<float, probeLags> lags{};
+    if (threshold > 0.f) {
+        // the low lags are cheap and shape most of the envelope; normalized, they ignore the level
+        autocorrelation(frame, correlation, probeLags + 1);
+        firstLag = probeLags + 1;
+        if (correlation[0] > 0.f) {
+            for (int lag = 0; lag < probeLags; ++lag)
+                lags[lag] = correlation[lag + 1] / correlation[0];
+            if (cache.modelOrder == frameModelOrder) {
+                float distance = 0.f;
+                for (int lag = 0; lag < probeLags; ++lag)
+                    distance += (lags[lag] - cache.lags[lag]) * (lags[lag] - cache.lags[lag]);
+                if (std::sqrt(distance) <= threshold)
+                    return true;
+            }
+        }
+    }
 
-    k[0] = - corrCoeff[1] / corrCoeff[0];
-    a[1][0] = k[0];
-    auto kPow2 = std::pow(k[0], 2);
-    E[0] = static_cast<float>((1 - kPow2) * corrCoeff[0]);
+    bool stable;
+    if (progress.params.estimator == Estimator::Burg) {
+        stable = burg(frame, LPCcoeffs, reflection).stable;
+    }
+    else {
+        // the recursion reads lags 0 to order
+        autocorrelation(frame, correlation, frameModelOrder + 1, firstLag);
+        stable = levinsonDurbin(correlation, LPCcoeffs, reflection).stable;
+    }
+    if (!stable)
+        unstableFrames.fetch_add(1, std::memory_order_relaxed);
+    cache.lags = lags;
+    cache.modelOrder = threshold > 0.f && correlation[0] > 0.f ? frameModelOrder : 0;
+    return false;
+}
 
-    for (int i = 2; i <= frameModelOrder; ++i) {
-        float sum = 0.f;
-        for (int j = 0; j <= i; ++j) {
-            sum += a[i-1][j] * corrCoeff[j + 1];
-        }
-        k[i - 1] = - sum / E[i - 1-1];
-        a[i][0] = k[i - 1];
+void LPCeffect::autocorrelation(std::span<const float> ofBuffer, univector<float>& coeffs, int numLags, int firstLag) {
+    const int length = static_cast<int>(ofBuffer.size());
+    if (!prefersFFTautocorrelation(numLags)) {
+        for (int lag = firstLag; lag < numLags; ++lag)
+            coeffs[lag] = dotProduct(ofBuffer.data(), ofBuffer.data() + lag, length - lag);
+        return;
+    }
+    // Wiener–Khinchin theorem, zero-padded to twice the length so that the lags do not wrap around
+    std::copy(ofBuffer.begin(), ofBuffer.end(), paddedSignal.begin());
+    std::fill(paddedSignal.begin() + length, paddedSignal.end(), 0.f);
+    paddedPlan->execute(paddedSpectrum.data(), paddedSignal.data(), paddedTemp.data());
+    std::transform(paddedSpectrum.begin(), paddedSpectrum.end(), paddedSpectrum.begin(), [](const std::complex<float>& x) {
+        return x * std::conj(x);
+    });
+    paddedPlan->execute(paddedSignal.data(), paddedSpectrum.data(), paddedTemp.data());
+    // the inverse transform is unnormalized, scale to match the direct path
+    const float scale = 1.f / static_cast<float>(paddedSignal.size());
+    for (int lag = 0; lag < numLags; ++lag)
+        coeffs[lag] = paddedSignal[lag] * scale;
+}
+
+bool LPCeffect::prefersFFTautocorrelation(int numLags) const {
+    // direct: one multiply-add per sample and lag; FFT: forward and inverse transform of the padded length,
+    // weighted for the FFT's overhead compared to a contiguous vectorized dot product
+    const auto paddedLength = static_cast<float>(2 * windowSize);
+    const float fftCost = 4.f * paddedLength * std::log2(paddedLength);
+    return static_cast<float>(numLags) * static_cast<float>(windowSize) > fftCost;
+}
 
-        for (int j = 1; j < i; ++j) {
-            a[i][j] = a[i - 1][j - 1] + k[i - 1] * a[i - 1][i - j - 1];
+float LPCeffect::dotProduct(const float* a, const float* b, int length) {
+    // independent partial sums let the compiler vectorize without reassociating a single sum
+    float partial[8] = {};
+    int i = 0;
+    for (; i + 8 <= length; i += 8)
+        for (int lane = 0; lane < 8; ++lane)
+            partial[lane] += a[i + lane] * b[i + lane];
+    float sum = 0.f;
+    for (; i < length; ++i)
+        sum += a[i] * b[i];
+    for (float p : partial)
+        sum += p;
+    return sum;
+}
+
+LPCeffect::LevinsonResult LPCeffect::levinsonDurbin(const univector<float>& corrCoeff, univector<float>& LPCcoeffs,
+                                                    univector<float>& reflection) const {
+    // capacity is reserved in prepare, the resize does not allocate
+    LPCcoeffs.resize(frameModelOrder + 1);
+    std::fill(LPCcoeffs.begin(), LPCcoeffs.end(), 0.f);
+    // unused orders stay zero, so that interpolating between frames of different orders is well-defined
+    std::fill(reflection.begin(), reflection.end(), 0.f);
+    LPCcoeffs[0] = 1.f;
+
+    LevinsonResult result{corrCoeff[0], true};
+    // silent frame: keep the identity filter
+    if (!(corrCoeff[0] > 0.f))
+        return result;
+
+    for (int i = 1; i <= frameModelOrder; ++i) {
+        float sum = corrCoeff[i];
+        for (int j = 1; j < i; ++j)
+            sum += LPCcoeffs[j] * corrCoeff[i - j];
+        float k = - sum / result.predictionError;
+        if (!(std::abs(k) < 1.f)) {
+            result.stable = false;
+            k = std::isnan(k) ? 0.f : std::copysign(maxReflection, k);
         }
 
-        kPow2 = std::pow(k[i - 1],2);
-        E[i - 1] = static_cast<float>((1 - kPow2) * E[i - 2]);
+        // order update a(j) += k * a(i - j), both ends at once so that one row is enough
+        for (int j = 1; j <= i / 2; ++j) {
+            const float front = LPCcoeffs[j];
+            const float back = LPCcoeffs[i - j];
+            LPCcoeffs[j] = front + k * back;
+            LPCcoeffs[i - j] = back + k * front;
+        }
+        LPCcoeffs[i] = k;
+        reflection[i - 1] = k;
+        result.predictionError *= 1 - k * k;
     }
-    univector<float> LPCcoeffs(frameModelOrder);
-    for (int x = 0; x <= frameModelOrder; ++x)
-        LPCcoeffs.push_back(a[frameModelOrder][frameModelOrder - x]);
+    return result;
+}
+
+LPCeffect::LevinsonResult LPCeffect::burg(std::span<const float> frame, univector<float>& LPCcoeffs,
+                                          univector<float>& reflection) {
+    // capacity is reserved in prepare, the resize does not allocate
+    LPCcoeffs.resize(frameModelOrder + 1);
+    std::fill(LPCcoeffs.begin(), LPCcoeffs.end(), 0.f);
+    std::fill(reflection.begin(), reflection.end(), 0.f);
+    LPCcoeffs[0] = 1.f;
 
-    return LPCcoeffs;
+    const int length = static_cast<int>(frame.size());
+    std::copy(frame.begin(), frame.end(), burgForward.begin());
+    std::copy(frame.begin(), frame.end(), burgBackward.begin());
+    LevinsonResult result{dotProduct(frame.data(), frame.data(), length) / static_cast<float>(length), true};
+    // silent frame: keep the identity filter
+    if (!(result.predictionError > 0.f))
+        return result;
+
+    for (int i = 1; i <= frameModelOrder && i < length; ++i) {
+        // forward errors f(n) and backward errors b(n - 1) for n = i ... length - 1; the backward errors are
+        // stored one place lower every order, so that both are at the same index and the update vectorizes
+        const int count = length - i;
+        float* forward = burgForward.data() + i;
+        float* backward = burgBackward.data();
+        const float cross = dotProduct(forward, backward, count);
+        const float energy = dotProduct(forward, forward, count) + dotProduct(backward, backward, count);
+        if (!(energy > 0.f))
+            break;
+        // |k| <= 1 by the Cauchy-Schwarz inequality, rounding can still reach it
+        float k = -2.f * cross / energy;
+        if (!(std::abs(k) < 1.f)) {
+            result.stable = false;
+            k = std::isnan(k) ? 0.f : std::copysign(maxReflection, k);
+        }
+
+        for (int n = 0; n < count; ++n) {
+            const float f = forward[n];
+            const float b = backward[n];
+            forward[n] = f + k * b;
+            backward[n] = b + k * f;
+        }
+
+        for (int j = 1; j <= i / 2; ++j) {
+            const float front = LPCcoeffs[j];
+            const float back = LPCcoeffs[i - j];
+            LPCcoeffs[j] = front + k * back;
+            LPCcoeffs[i - j] = back + k * front;
+        }
+        LPCcoeffs[i] = k;
+        reflection[i - 1] = k;
+        result.predictionError *= 1 - k * k;
+    }
+    return result;
 }
 
-void LPCeffect::matchPower(univector<float>& input, const univector<float>& reference) const {
+void LPCeffect::matchPower(univector<float>& input, std::span<const float> reference) const {
     float sumOfSquares = std::inner_product(reference.begin(), reference.end(), reference.begin(), 0.0f);
     float refPower = std::sqrt(sumOfSquares / static_cast<float>(windowSize));
 
     sumOfSquares = std::inner_product(input.begin(), input.end(), input.begin(), 0.0f);
     float inputPower = std::sqrt(sumOfSquares / static_cast<float>(windowSize));
 
-    input = mul(input, min(refPower, inputPower) / max(refPower, inputPower));
+    const float gain = min(refPower, inputPower) / max(refPower, inputPower);
+    std::transform(input.begin(), input.end(), input.begin(), [gain](float x) {
+        return x * gain;
+    });
 }
 
 void LPCeffect::mulVectorWith(univector<float>& vec1, const univector<float>& vec2) {
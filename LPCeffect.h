@@ -2,15 +2,169 @@
 #include <kfr/base.hpp>
 #include <kfr/dft.hpp>
 #include <kfr/dsp.hpp>
+#include <memory>
+#include <span>
+#include <vector>
 #include "ShiftEffect.cpp"
+#include "FrameWorker.cpp"
+#include "StageTelemetry.cpp"
 
 using namespace kfr;
 
 class LPCeffect {
 public:
     explicit LPCeffect(const int sampleRate);
+
+    /**
+     * @brief Creates the FFT plans of every window size and their workspaces. Must be called before processing, off the audio thread.
+     */
+    void prepare();
+
+    /**
+     * @brief Analysis window sizes: 1024, 2048 and 4096 samples.
+     */
+    enum class WindowSizeEnum {
+        S, M, L
+    };
+
+    /**
+     * @brief Switches the analysis window, which sets the latency. Drops the frame in flight and restarts the buffers, does not allocate.
+     *
+     * @param size The new window size.
+     */
+    void setWindowSize(WindowSizeEnum size);
+
+    /**
+     * @brief Overlap of consecutive analysis frames: 50%, 75% and 87.5%.
+     */
+    enum class OverlapEnum {
+        Half, ThreeQuarters, SevenEighths
+    };
+
+    /**
+     * @brief Switches the frame overlap. Higher overlap gives smoother envelopes for proportionally more processing.
+     * Drops the frame in flight and restarts the buffers, does not allocate.
+     *
+     * @param newOverlap The new overlap.
+     */
+    void setOverlap(OverlapEnum newOverlap);
+
+    /**
+     * @brief How the voice envelope is applied to the carrier residuals.
+     *
+     * Spectral divides the residual spectrum by the spectrum of the predictor, a circular approximation.
+     * Lattice runs the all-pole filter in the time domain on the reflection coefficients, interpolated across the hop.
+     */
+    enum class SynthesisEngine {
+        Spectral, Lattice
+    };
+
+    /**
+     * @brief How the LPC predictor of a frame is estimated.
+     *
+     * Autocorrelation solves the normal equations of the frame's autocorrelation with Levinson-Durbin.
+     * Burg minimizes the forward and backward prediction errors on the samples themselves, which resolves
+     * formants better on short frames, and its filter is stable by construction.
+     */
+    enum class Estimator {
+        Autocorrelation, Burg
+    };
+
+    /**
+     * @brief Effect parameters, captured once per frame.
+     */
+    struct Params {
+        int modelOrder = 70;
+        float shiftVoice1 = 1.f;
+        float shiftVoice2 = 1.f;
+        float shiftVoice3 = 1.f;
+        bool enableLPC = false;
+        float passthrough = 1.f;
+        SynthesisEngine synthesis = SynthesisEngine::Spectral;
+        // distance of the normalized low autocorrelation lags below which the previous predictor is kept, 0: always recompute
+        float envelopeReuse = 0.f;
+        Estimator estimator = Estimator::Autocorrelation;
+    };
+
+    /**
+     * @brief Where completed frames are processed.
+     *
+     * Realtime processes the frame inside the callback that completes it.
+     * Worker hands the frame to a FrameWorker and picks the result up one hop later.
+     * Amortized spreads the frame's stages evenly over the following hop on the calling thread.
+     */
+    enum class ProcessingMode {
+        Realtime, Worker, Amortized
+    };
+
     [[nodiscard]] int getLatency() const {
-        return windowSize;
+        return processingMode == ProcessingMode::Realtime ? windowSize : windowSize + hopSize;
+    }
+
+    /**
+     * @brief Registers this instance's job queue with a worker. Must be called while the worker is stopped.
+     *
+     * @param worker The worker to render frames in Worker mode.
+     */
+    void attachWorker(FrameWorker& worker);
+
+    /**
+     * @brief Switches the processing mode. Drops the frame in flight and restarts the buffers, does not allocate.
+     *
+     * @param mode The new processing mode.
+     */
+    void setProcessingMode(ProcessingMode mode);
+
+    /**
+     * @brief Whether the audio thread waits for a frame the worker has not finished within one hop, rather than cancel
+     * it and repeat the previous frame. For offline rendering, where there is no deadline to keep.
+     *
+     * @param wait Wait for late frames.
+     */
+    void setWaitForLateFrames(bool wait) {
+        waitForLateFrames = wait;
+    }
+
+    /**
+     * @brief Number of frames the worker did not finish within one hop.
+     */
+    [[nodiscard]] int getDeadlineMisses() const {
+        return deadlineMisses.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Number of LPC analyses whose reflection coefficients had to be clamped to keep the filter stable.
+     */
+    [[nodiscard]] int getUnstableFrames() const {
+        return unstableFrames.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Number of voice frames that kept the previous predictor, see Params::envelopeReuse.
+     */
+    [[nodiscard]] int getReusedVoiceEnvelopes() const {
+        return reusedVoiceEnvelopes.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Number of carrier frames that kept the previous predictor, see Params::envelopeReuse.
+     */
+    [[nodiscard]] int getReusedCarrierEnvelopes() const {
+        return reusedCarrierEnvelopes.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Number of channel frames skipped by the silence gate.
+     */
+    [[nodiscard]] int getSilentFrames() const {
+        return silentFrames.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Stage timing of the frames this instance processes, to be drained by a TelemetryCollector.
+     */
+    StageTelemetry& getTelemetry() {
+        return telemetry;
     }
 
     /**
@@ -29,34 +183,260 @@ public:
      */
     float sendSample(float carrierSample, float voiceSample, float modelOrder, float shiftVoice1,  float shiftVoice2, float shiftVoice3, bool enableLPC, float passthrough);
 
+    /**
+     * @brief Sends a block of samples to the buffer collection and returns the processed block.
+     *
+     * @param carrier The input carrier (excitation) samples.
+     * @param voice The input voice samples.
+     * @param out The processed output samples, may be the same buffer as carrier.
+     * @param numSamples Number of samples in the block.
+     * @param params Effect parameters for the whole block.
+     */
+    void processBlock(const float* carrier, const float* voice, float* out, int numSamples, const Params& params);
+
+    /**
+     * @brief Sets the effects of the other channels whose frames this one processes when linked. Must be called
+     * off the audio thread. The followers must share this effect's settings, applied to this effect first.
+     *
+     * @param effects The effects of the other channels, in channel order.
+     */
+    void setFollowers(std::vector<LPCeffect*> effects);
+
+    /**
+     * @brief Switches between processing the followers' frames with this effect's and leaving them to process their own.
+     * Drops the frames in flight and restarts the buffers of all, does not allocate.
+     *
+     * @param linked Whether the followers are processed by processLinkedBlock.
+     */
+    void setLinked(bool linked);
+
+    /**
+     * @brief Sends blocks of this and the followers' channels, processed in step in one frame job per hop.
+     *
+     * A channel whose voice frame is bit-identical to an earlier channel's reuses its shifted voice and envelope,
+     * one whose carrier frame is identical reuses its residuals, and one with both identical reuses its output.
+     *
+     * @param carriers The input carrier (excitation) samples of each channel, this effect's first.
+     * @param voices The input voice samples of each channel.
+     * @param outs The processed output samples of each channel, may be the same buffers as carriers.
+     * @param numChannels Number of channels, at most one more than the followers.
+     * @param numSamples Number of samples in the block.
+     * @param params Effect parameters for the whole block.
+     */
+    void processLinkedBlock(const float* const* carriers, const float* const* voices, float* const* outs, int numChannels,
+                            int numSamples, const Params& params);
+
 private:
+    // times the stages one by one, see Benchmark.cpp
+    friend class LPCbenchmark;
+    // checks the kernels against references, see KernelTest.cpp
+    friend class LPCkernelTest;
+
     enum class FFToperation {
         Convolution, IIR
     };
 
     /**
-     * @brief The LPC effect.
+     * @brief Outcome of the Levinson-Durbin recursion besides the coefficients.
+     */
+    struct LevinsonResult {
+        float predictionError = 0.f;
+        bool stable = true;
+    };
+
+    /**
+     * @brief Resumable stages of the effect chain.
+     */
+    enum class Stage {
+        ShiftVoices, MatchShifted, VoiceAnalysis, CarrierResiduals, Synthesis, Mix, Done
+    };
+
+    /**
+     * @brief One analysis frame of this and the linked channels, rendered by the worker or, past its deadline, by the audio thread.
      *
-     * @param voice The voice signal.
-     * @param carrier The carrier (excitation) signal.
+     * The frame is read from the rings, which keep it intact until it is collected. Each channel's output is
+     * written to the output of that channel's task.
+     */
+    struct FrameTask final : FrameJob {
+        void render() override {
+            owner->processing(*this);
+        }
+
+        LPCeffect* owner = nullptr;
+        // set by the audio thread to stop the frame after the step in progress
+        std::atomic<bool> cancelled{false};
+        // start of the frame in the rings, the same for every linked channel
+        int frameStart = 0;
+        int numLinked = 0;
+        univector<float> output;
+        Params params;
+    };
+
+    /**
+     * @brief Sizes the buffers, hop and plans for the current window size and overlap and restarts the buffers.
+     */
+    void configureWindow();
+
+    /**
+     * @brief Empties the rings and the output accumulator, the next frame is due after a whole window.
+     * A frame in flight is cancelled and dropped, the task is left idle.
+     */
+    void restartBuffers();
+
+    /**
+     * @brief Processes blocks of this channel and numLinked followers in step.
+     */
+    void processChannels(const float* const* carriers, const float* const* voices, float* const* outs, int numLinked,
+                         int numSamples, const Params& params);
+
+    /**
+     * @brief This effect for channel 0, the followers after it.
+     */
+    [[nodiscard]] LPCeffect* linkedChannel(int channel) {
+        return channel == 0 ? this : followers[channel - 1];
+    }
+
+    /**
+     * @brief Appends samples to the input rings.
+     *
+     * @param carrier The input carrier (excitation) samples.
+     * @param voice The input voice samples.
+     * @param numSamples Number of samples, at most the ring size.
+     */
+    void writeInput(const float* carrier, const float* voice, int numSamples);
+
+    /**
+     * @brief Processes or submits the frame ending with the last sample written, and overlap-adds the frame that is due.
+     *
+     * @param numLinked Number of followers processed with the frame.
+     * @param params Effect parameters for the frame.
+     */
+    void frameBoundary(int numLinked, const Params& params);
+
+    /**
+     * @brief Overlap-adds the output of a processed frame to each of its channels.
+     *
+     * @param task The processed frame.
+     */
+    void overlapFrame(const FrameTask& task);
+
+    /**
+     * @brief Overlap-adds the previous frame's output of each channel of a task again, in place of a frame that missed
+     * its deadline.
+     *
+     * @param task The late frame.
+     */
+    void repeatFrame(const FrameTask& task);
+
+    /**
+     * @brief Adds a processed frame to the output accumulator, starting at the next output sample.
+     *
+     * @param frame The processed frame.
+     */
+    void overlapAdd(const univector<float>& frame);
+
+    /**
+     * @brief Reads and clears the accumulated output of consecutive samples.
+     *
+     * @param out The output samples.
+     * @param numSamples Number of samples to read.
+     */
+    void readOutput(float* out, int numSamples);
+
+    /**
+     * @brief Queues a completed frame for the worker, or stages it in amortized mode.
+     *
+     * @param task The task to fill. Must have been collected.
+     * @param frameStart Start of the frame in the rings.
+     * @param numLinked Number of followers processed with the frame.
+     * @param params Effect parameters for the frame.
+     */
+    void submitFrame(FrameTask& task, int frameStart, int numLinked, const Params& params);
+
+    /**
+     * @brief Finishes the frame of a task, rendering it here if the worker has not started it by the deadline.
+     *
+     * The audio thread does not wait for a worker that is still mid-frame: the frame is cancelled and left in flight,
+     * and dropped when it is collected at the next boundary.
+     *
+     * @param task The task submitted one hop earlier.
      *
-     * @return The cross-synthesis processed signal.
+     * @return True if the frame is done, its output is then in the task.
      */
-    univector<float> processLPC(const univector<float>& voice, const univector<float>& carrier);
+    bool collectFrame(FrameTask& task);
 
     /**
-     * @brief Processes collected buffers using the effect chain.
+     * @brief Stops the frame of a task after the step in progress and drops it. Leaves the task idle.
+     *
+     * @param task The task to cancel.
+     */
+    void cancelFrame(FrameTask& task);
+
+    /**
+     * @brief Processes the frame of a task using the effect chain, all stages at once.
+     *
+     * @param task The frame to process.
+     */
+    void processing(FrameTask& task);
+
+    /**
+     * @brief Starts processing the frame of a task, finds the channels that can reuse an earlier channel's work.
+     * The stages are then run by processStep.
+     *
+     * @param task The frame to process.
+     */
+    void beginProcessing(FrameTask& task);
+
+    /**
+     * @brief Runs one step of the frame: a step of the channel being processed.
+     *
+     * @return True while steps remain.
+     */
+    bool processStep();
+
+    /**
+     * @brief Starts processing this channel's frame. The stages are then run by channelStep.
      *
      * @param overwrite The buffer to overwrite with the output.
      * @param voice The voice signal.
      * @param carrier The carrier (excitation) signal.
-     * @param shiftVoice1 The first voice shift ratio.
-     * @param shiftVoice2 The second voice shift ratio.
-     * @param shiftVoice3 The third voice shift ratio..
-     * @param enableLPC Enable or disable LPC vocoder effect.
-     * @param passthrough Dry / wet control.
+     * @param params Effect parameters for the frame.
+     * @param voiceSource An earlier channel with the same voice frame, whose analysis is reused, or nullptr.
+     * @param carrierSource An earlier channel with the same carrier frame, whose residuals are reused, or nullptr.
+     */
+    void beginChannel(univector<float>& overwrite, std::span<const float> voice, std::span<const float> carrier,
+                      const Params& params, const LPCeffect* voiceSource, const LPCeffect* carrierSource);
+
+    /**
+     * @brief Runs one step of this channel's effect chain: a single grain of a shifted voice or one LPC stage.
+     *
+     * @return True while steps remain.
+     */
+    bool channelStep();
+
+    /**
+     * @brief Whether a frame is below the silence threshold throughout.
+     *
+     * @param frame The frame to check.
      */
-    void processing(univector<float>& overwrite, const univector<float>& voice, const univector<float>& carrier, float shiftVoice1,  float shiftVoice2, float shiftVoice3, bool enableLPC, float passthrough);
+    static bool isSilent(std::span<const float> frame);
+
+    /**
+     * @brief Writes the dry part of a silent frame and skips the effect chain.
+     */
+    void skipSilentFrame();
+
+    /**
+     * @brief Takes the shifted voice and envelope of the voice source, or its whole output if the carrier source is the same.
+     */
+    void reuseVoiceAnalysis();
+
+    /**
+     * @brief Runs the steps of the amortized frame that are due after the given number of samples.
+     *
+     * @param samples Samples since the previous call.
+     */
+    void advanceAmortized(int samples);
 
     /**
    * @brief Performs FFT-based operations (convolution or IIR filtering).
@@ -64,37 +444,108 @@ private:
    * @param o FFT operation (Convolution or IIR filter).
    * @param inputBuffer The input signal to which the operation is applied.
    * @param coefficients The LPC coefficients.
-   *
-   * @return Convolution or filter output.
+   * @param output Convolution or filter output.
    */
-    univector<float> FFToperations(FFToperation o, const univector<float>& inputBuffer, const univector<float>& coefficients);
+    void FFToperations(FFToperation o, std::span<const float> inputBuffer, const univector<float>& coefficients, univector<float>& output);
+
+    /**
+     * @brief Filters the residuals through the all-pole lattice of the voice reflection coefficients.
+     *
+     * Over the first hop the coefficients move linearly from the previous frame's, which keeps every
+     * intermediate filter stable. The filter starts from rest, the output is windowed for the overlap.
+     *
+     * @param residuals The carrier residual signal.
+     * @param output The synthesized signal.
+     */
+    void latticeSynthesis(const univector<float>& residuals, univector<float>& output);
 
     /**
-     * @brief Calculates the autocorrelation of a signal.
+     * @brief Calculates the first lags of the (linear, not circular) autocorrelation of a signal.
+     *
+     * Lags are computed directly when there are few of them, or by a zero-padded FFT when that is cheaper.
      *
      * @param fromBufer Input signal.
+     * @param coeffs Output coefficients, at least numLags long.
+     * @param numLags Number of lags to compute, starting with lag 0.
+     * @param firstLag Lags below it are already in coeffs. The FFT path computes them again.
+     */
+    void autocorrelation(std::span<const float> fromBufer, univector<float>& coeffs, int numLags, int firstLag = 0);
+
+    /**
+     * @brief Normalized low autocorrelation lags of the frame a cached predictor was computed from.
+     */
+    struct EnvelopeCache {
+        static constexpr int probeLags = 8;
+        std::array<float, probeLags> lags{};
+        // model order of the cached predictor, 0 if there is none
+        int modelOrder = 0;
+    };
+
+    /**
+     * @brief Computes the predictor of a frame, or keeps the previous one if the frame's normalized low lags are within
+     * the reuse threshold of the frame it was computed from. Comparing with that frame rather than the last one
+     * keeps slow drifts from accumulating.
+     *
+     * @param frame The analysed signal.
+     * @param cache The lags the current predictor was computed from, updated when it is recomputed.
+     * @param LPCcoeffs LPC coefficients 1, a1 ... a(order), kept or recomputed.
+     * @param reflection Reflection coefficients k1 ... k(order), kept or recomputed.
+     * @param threshold Largest distance of the lags for which the predictor is kept, 0 to always recompute.
+     *
+     * @return True if the predictor was kept.
+     */
+    bool updateEnvelope(std::span<const float> frame, EnvelopeCache& cache, univector<float>& LPCcoeffs,
+                        univector<float>& reflection, float threshold);
+
+    /**
+     * @brief Whether the FFT path of autocorrelation is cheaper than the direct one.
      *
-     * @return Equal length output coefficients vector.
+     * @param numLags Number of lags to compute.
      */
-    static univector<float> autocorrelation(const univector<float>& fromBufer);
+    [[nodiscard]] bool prefersFFTautocorrelation(int numLags) const;
 
     /**
-    * @brief Performs the Levinson-Durbin recursion for LPC analysis.
+     * @brief Dot product of two signals.
+     *
+     * @param a First signal.
+     * @param b Second signal.
+     * @param length Number of samples.
+     *
+     * @return The sum of products.
+     */
+    static float dotProduct(const float* a, const float* b, int length);
+
+    /**
+    * @brief Performs the Levinson-Durbin recursion for LPC analysis, in place in O(order) memory.
     *
-    * @param ofBuffer Autocorrelation coefficients.
+    * Reflection coefficients with |k| >= 1 are clamped, so the predictor is always minimum phase.
     *
-    * @return LPC coefficients.
+    * @param ofBuffer Autocorrelation coefficients, lags 0 to order.
+    * @param LPCcoeffs LPC coefficients 1, a1 ... a(order).
+    * @param reflection Reflection coefficients k1 ... k(order).
+    *
+    * @return Prediction error and stability of the frame.
     */
-    [[nodiscard]] univector<float> levinsonDurbin(const univector<float>& ofBuffer) const;
+    LevinsonResult levinsonDurbin(const univector<float>& ofBuffer, univector<float>& LPCcoeffs, univector<float>& reflection) const;
+
+    /**
+     * @brief Burg's method for LPC analysis, in O(length * order) on the frame samples.
+     *
+     * @param frame The analysed signal.
+     * @param LPCcoeffs LPC coefficients 1, a1 ... a(order).
+     * @param reflection Reflection coefficients k1 ... k(order).
+     *
+     * @return Prediction error per sample and stability of the frame.
+     */
+    LevinsonResult burg(std::span<const float> frame, univector<float>& LPCcoeffs, univector<float>& reflection);
 
     /**
       * @brief Extracts the residual signal after LPC analysis.
       *
       * @param ofBuffer An input signal.
-      *
-      * @return Residual signal.
+      * @param residuals Residual signal.
       */
-    univector<float> getResiduals(const univector<float>& ofBuffer);
+    void getResiduals(std::span<const float> ofBuffer, univector<float>& residuals);
 
     /**
      * @brief Matches the power of the input signal to the reference signal.
@@ -102,7 +553,7 @@ private:
      * @param input The signal to be adjusted.
      * @param reference The reference signal.
      */
-    void matchPower(univector<float>& input, const univector<float>& reference) const;
+    void matchPower(univector<float>& input, std::span<const float> reference) const;
 
     static void mulVectorWith(univector<float>& vec1, const univector<float>& vec2);
     static void mulVectorWith(univector<std::complex<float>>& vec1, const univector<std::complex<float>>& vec2);
@@ -114,9 +565,6 @@ private:
     univector<fbase, 2048> hannWindowM = window_hann(2048);
     univector<fbase, 4096> hannWindowL = window_hann(4096);
 
-    enum class WindowSizeEnum {
-        S, M, L
-    };
     WindowSizeEnum windowSizeEnum;
 
     std::unordered_map<WindowSizeEnum, univector<fbase>> hannWindow = {
@@ -125,21 +573,104 @@ private:
             {WindowSizeEnum::L, hannWindowL}
     };
 
-    int index1 = 0;
-    int index2 = 0;
-
-    const float overlap = 0.5;
+    OverlapEnum overlapEnum;
+    float overlap = 0.5f;
     int overlapSize = 0;
     int hopSize = 0;
+    float overlapGain = 1.f;
 
     int frameModelOrder = 70;
+    static constexpr int maxModelOrder = 76;
+
+    // input rings of ringSize samples, stored twice in a row; samplesToFrame counts down to the next frame
+    univector<float> carrierRing;
+    univector<float> voiceRing;
+    int ringSize = 0;
+    int ringPos = 0;
+    int samplesToFrame = 0;
+    // overlapped output of the next windowSize samples, starting at accumulatorPos
+    univector<float> outputAccumulator;
+    int accumulatorPos = 0;
+    // output of the frame overlapped last, repeated when the next one is late
+    univector<float> previousOutput;
+
+    std::unique_ptr<ShiftEffect> shiftEffect;
+
+    ProcessingMode processingMode = ProcessingMode::Realtime;
+    FrameWorker* frameWorker = nullptr;
+    FrameWorker::Queue jobQueue;
+    FrameTask frameTask;
+    bool waitForLateFrames = false;
+    // effects of the other channels, processed with this one's frames while linked
+    std::vector<LPCeffect*> followers;
+    bool linked = false;
+    std::atomic<int> deadlineMisses{0};
+    std::atomic<int> unstableFrames{0};
+    std::atomic<int> silentFrames{0};
+    std::atomic<int> reusedVoiceEnvelopes{0};
+    std::atomic<int> reusedCarrierEnvelopes{0};
+    StageTelemetry telemetry;
+    // peak below which a frame is silent: a silent voice or, with LPC, a silent carrier leaves only the dry signal
+    static constexpr float silenceThreshold = 0.0001f;
+
+    // the frame in progress, kept between steps
+    struct Progress {
+        univector<float>* output = nullptr;
+        std::span<const float> voice;
+        std::span<const float> carrier;
+        Params params;
+        Stage stage = Stage::Done;
+        std::array<float, ShiftEffect::maxVoices> shifts{};
+        bool shifting = false;
+        int stepsTotal = 0;
+        bool silent = false;
+        const LPCeffect* voiceSource = nullptr;
+        const LPCeffect* carrierSource = nullptr;
+    } progress;
+    // the frame of all linked channels in progress: the channel being stepped and the steps of all
+    struct LinkedProgress {
+        int numLinked = 0;
+        int channel = 0;
+        int stepsDone = 0;
+        int stepsTotal = 0;
+    } linkedProgress;
+    univector<float> frameResult;
+    univector<float> voiceLPC;
+    univector<float> carrierResiduals;
+    univector<float> synthesized;
+
+    // FFT plans for every window size, the one in use and its workspaces, created in prepare
+    std::array<std::unique_ptr<dft_plan_real<float>>, 3> dftPlans;
+    dft_plan_real<float>* dftPlan = nullptr;
+    univector<u8> dftTemp;
+    univector<std::complex<float>> spectrum;
+    univector<std::complex<float>> coeffSpectrum;
+    univector<float> paddedCoeff;
+    univector<float> correlation;
+    univector<float> synthesisWindow;
+
+    // zero-padded FFT of twice the window for autocorrelation at high orders
+    std::array<std::unique_ptr<dft_plan_real<float>>, 3> paddedPlans;
+    dft_plan_real<float>* paddedPlan = nullptr;
+    univector<u8> paddedTemp;
+    univector<float> paddedSignal;
+    univector<std::complex<float>> paddedSpectrum;
 
-    univector<float> carrierBuffer1;
-    univector<float> carrierBuffer2;
-    univector<float> sideChainBuffer1;
-    univector<float> sideChainBuffer2;
-    univector<float> filteredBuffer1;
-    univector<float> filteredBuffer2;
+    univector<float> carrierLPC;
+    univector<float> voiceReflection;
+    univector<float> carrierReflection;
+    EnvelopeCache voiceEnvelope;
+    EnvelopeCache carrierEnvelope;
+    // lattice synthesis: reflection coefficients of the previous frame and the backward errors
+    univector<float> previousReflection;
+    univector<float> latticeState;
+    // Burg's method: forward and backward prediction errors of the frame
+    univector<float> burgForward;
+    univector<float> burgBackward;
+    // largest magnitude an unstable reflection coefficient is clamped to
+    static constexpr float maxReflection = 0.9999f;
 
-    ShiftEffect* shiftEffect;
+    // amortized mode: the task being processed in steps and samples elapsed since it was submitted
+    FrameTask* stagedTask = nullptr;
+    int stagedElapsed = 0;
 };
\ No newline at end of file
@@ -0,0 +1,354 @@
+// Headless renderer: runs the effect over audio files without a host or the WebView editor.
+//
+// prescient-render --carrier guitar.wav --voice speech.wav --out result.wav [--preset p.txt] [--<parameterId> value]
+// prescient-render --batch jobs.txt [--jobs N] [--block N] [--preset p.txt] [--<parameterId> value]
+//
+// Parameters use the plugin's IDs, see MyAudioProcessor::createParameterLayout.
+#include <juce_audio_formats/juce_audio_formats.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "LPCeffect.cpp"
+
+namespace {
+
+/**
+ * @brief Everything a render needs besides the files. Starts from the plugin's default parameter values.
+ */
+struct RenderSettings {
+    LPCeffect::Params params{76, 1.f, 1.f, 1.f, false, 1.f};
+    LPCeffect::WindowSizeEnum windowSize = LPCeffect::WindowSizeEnum::M;
+    LPCeffect::OverlapEnum overlap = LPCeffect::OverlapEnum::Half;
+    // monostereo, applied to the first channel pair as in the plugin
+    float width = 0.5f;
+    // samples read, processed and written at once
+    int blockSize = 1 << 16;
+};
+
+struct RenderJob {
+    juce::File carrier;
+    juce::File voice;
+    juce::File output;
+};
+
+/**
+ * @brief Sets a plugin parameter by its ID, clamped to the plugin's range.
+ *
+ * @param settings The settings to change.
+ * @param id The parameter ID.
+ * @param value The plain parameter value.
+ *
+ * @return False if the ID is unknown.
+ */
+bool setParameter(RenderSettings& settings, const juce::String& id, float value) {
+    auto& params = settings.params;
+    if (id == "modelOrder")
+        params.modelOrder = juce::jlimit(6, 76, juce::roundToInt(value));
+    else if (id == "passthrough")
+        params.passthrough = juce::jlimit(0.f, 1.f, value);
+    else if (id == "enableLPC")
+        params.enableLPC = value > 0.99f;
+    else if (id == "shiftVoice1")
+        params.shiftVoice1 = juce::jlimit(0.6f, 2.f, value);
+    else if (id == "shiftVoice2")
+        params.shiftVoice2 = juce::jlimit(0.6f, 2.f, value);
+    else if (id == "shiftVoice3")
+        params.shiftVoice3 = juce::jlimit(0.6f, 2.f, value);
+    else if (id == "monostereo")
+        settings.width = juce::jlimit(0.f, 1.f, value);
+    else if (id == "synthesis")
+        params.synthesis = value > 0.99f ? LPCeffect::SynthesisEngine::Lattice : LPCeffect::SynthesisEngine::Spectral;
+    else if (id == "latencyMode")
+        settings.windowSize = static_cast<LPCeffect::WindowSizeEnum>(juce::jlimit(0, 2, juce::roundToInt(value)));
+    else if (id == "overlap")
+        settings.overlap = static_cast<LPCeffect::OverlapEnum>(juce::jlimit(0, 2, juce::roundToInt(value)));
+    else if (id == "envelopeReuse")
+        params.envelopeReuse = juce::jlimit(0.f, 0.1f, value);
+    else if (id == "estimator")
+        params.estimator = value > 0.99f ? LPCeffect::Estimator::Burg : LPCeffect::Estimator::Autocorrelation;
+    else if (id == "processingMode" || id == "parallelChannels") {
+        // scheduling only, the offline render always processes frames in place and files in parallel
+    }
+    else
+        return false;
+    return true;
+}
+
+/**
+ * @brief Reads "parameterId = value" lines, '#' starts a comment.
+ *
+ * @return An error message, empty on success.
+ */
+juce::String loadPreset(RenderSettings& settings, const juce::File& file) {
+    if (!file.existsAsFile())
+        return "preset not found: " + file.getFullPathName();
+    juce::StringArray lines;
+    file.readLines(lines);
+    for (int i = 0; i < lines.size(); ++i) {
+        const auto line = lines[i].upToFirstOccurrenceOf("#", false, false).trim();
+        if (line.isEmpty())
+            continue;
+        const auto id = line.upToFirstOccurrenceOf("=", false, false).trim();
+        const auto value = line.fromFirstOccurrenceOf("=", false, false).trim();
+        if (!line.contains("=") || value.isEmpty() || !setParameter(settings, id, value.getFloatValue()))
+            return file.getFileName() + ":" + juce::String(i + 1) + ": invalid line: " + lines[i];
+    }
+    return {};
+}
+
+/**
+ * @brief Renders one carrier and voice pair to a 32-bit float WAV file.
+ *
+ * The output has the carrier's length and channels. The effect's latency is removed and its tail flushed with silence.
+ *
+ * @param job The files.
+ * @param settings Parameters and block size.
+ * @param formats Readers for the input formats, one instance per thread.
+ * @param realtimeFactor Duration of the audio divided by the time it took to render.
+ *
+ * @return An error message, empty on success.
+ */
+juce::String render(const RenderJob& job, const RenderSettings& settings, juce::AudioFormatManager& formats,
+                    double& realtimeFactor) {
+    const auto startTime = std::chrono::steady_clock::now();
+    std::unique_ptr<juce::AudioFormatReader> carrierReader(formats.createReaderFor(job.carrier));
+    if (carrierReader == nullptr)
+        return "cannot read " + job.carrier.getFullPathName();
+    std::unique_ptr<juce::AudioFormatReader> voiceReader(formats.createReaderFor(job.voice));
+    if (voiceReader == nullptr)
+        return "cannot read " + job.voice.getFullPathName();
+    const double sampleRate = carrierReader->sampleRate;
+    if (voiceReader->sampleRate != sampleRate)
+        return "sample rates differ: " + job.carrier.getFileName() + " and " + job.voice.getFileName();
+
+    const int numChannels = static_cast<int>(carrierReader->numChannels);
+    const int numVoiceChannels = static_cast<int>(voiceReader->numChannels);
+    const auto length = carrierReader->lengthInSamples;
+    if (numChannels == 0 || numVoiceChannels == 0)
+        return "no audio channels";
+
+    job.output.deleteFile();
+    auto stream = job.output.createOutputStream();
+    if (stream == nullptr)
+        return "cannot write " + job.output.getFullPathName();
+    std::unique_ptr<juce::AudioFormatWriter> writer(juce::WavAudioFormat().createWriterFor(
+            stream.get(), sampleRate, static_cast<unsigned int>(numChannels), 32, {}, 0));
+    if (writer == nullptr)
+        return "cannot write " + job.output.getFullPathName();
+    stream.release();
+
+    // the channels are processed in step, like the plugin with parallel channels off
+    std::vector<std::unique_ptr<LPCeffect>> effects;
+    for (int channel = 0; channel < numChannels; ++channel) {
+        effects.push_back(std::make_unique<LPCeffect>(static_cast<int>(sampleRate)));
+        auto& effect = *effects.back();
+        effect.prepare();
+        effect.setWindowSize(settings.windowSize);
+        effect.setOverlap(settings.overlap);
+    }
+    std::vector<LPCeffect*> followers;
+    for (int channel = 1; channel < numChannels; ++channel)
+        followers.push_back(effects[channel].get());
+    effects[0]->setFollowers(std::move(followers));
+    effects[0]->setLinked(true);
+    const int latency = effects[0]->getLatency();
+
+    const int blockSize = settings.blockSize;
+    juce::AudioBuffer<float> carrier(numChannels, blockSize);
+    juce::AudioBuffer<float> voice(numVoiceChannels, blockSize);
+    juce::AudioBuffer<float> output(numChannels, blockSize);
+    std::vector<const float*> carrierPointers(numChannels);
+    std::vector<const float*> voicePointers(numChannels);
+    std::vector<const float*> written(numChannels);
+    for (int channel = 0; channel < numChannels; ++channel) {
+        carrierPointers[channel] = carrier.getReadPointer(channel);
+        // channels beyond the voice's use its last channel
+        voicePointers[channel] = voice.getReadPointer(std::min(channel, numVoiceChannels - 1));
+    }
+
+    juce::ScopedNoDenormals noDenormals;
+    const auto voiceLength = voiceReader->lengthInSamples;
+    // past the inputs, silence pushes the last frames out
+    const auto total = length + latency;
+    for (juce::int64 position = 0; position < total; position += blockSize) {
+        const int numSamples = static_cast<int>(std::min<juce::int64>(blockSize, total - position));
+        carrier.clear();
+        voice.clear();
+        if (position < length)
+            carrierReader->read(carrier.getArrayOfWritePointers(), numChannels, position,
+                                static_cast<int>(std::min<juce::int64>(numSamples, length - position)));
+        if (position < voiceLength)
+            voiceReader->read(voice.getArrayOfWritePointers(), numVoiceChannels, position,
+                              static_cast<int>(std::min<juce::int64>(numSamples, voiceLength - position)));
+
+        {
+            // held to the plugin's rule, so that builds with PRESCIENT_CHECK_ALLOCATIONS check the chain
+            ScopedNoAllocation noAllocation;
+            effects[0]->processLinkedBlock(carrierPointers.data(), voicePointers.data(), output.getArrayOfWritePointers(),
+                                           numChannels, numSamples, settings.params);
+        }
+
+        if (numChannels >= 2) {
+            auto* channelL = output.getWritePointer(0);
+            auto* channelR = output.getWritePointer(1);
+            for (int sample = 0; sample < numSamples; ++sample) {
+                const float side = settings.width * 0.5f * (channelL[sample] - channelR[sample]);
+                const float mid = (2 - settings.width) * 0.5f * (channelL[sample] + channelR[sample]);
+                channelL[sample] = mid + side;
+                channelR[sample] = mid - side;
+            }
+        }
+
+        // the first latency samples precede the input
+        const int skip = static_cast<int>(std::clamp<juce::int64>(latency - position, 0, numSamples));
+        for (int channel = 0; channel < numChannels; ++channel)
+            written[channel] = output.getReadPointer(channel, skip);
+        if (numSamples > skip && !writer->writeFromFloatArrays(written.data(), numChannels, numSamples - skip))
+            return "write failed: " + job.output.getFullPathName();
+    }
+    writer.reset();
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+    realtimeFactor = static_cast<double>(length) / sampleRate / std::max(elapsed.count(), 1e-9);
+    return {};
+}
+
+/**
+ * @brief Reads "carrier voice output" lines, '#' starts a comment. Relative paths are relative to the list.
+ *
+ * @return An error message, empty on success.
+ */
+juce::String loadBatch(std::vector<RenderJob>& jobs, const juce::File& file) {
+    if (!file.existsAsFile())
+        return "batch list not found: " + file.getFullPathName();
+    juce::StringArray lines;
+    file.readLines(lines);
+    const auto directory = file.getParentDirectory();
+    for (int i = 0; i < lines.size(); ++i) {
+        const auto line = lines[i].upToFirstOccurrenceOf("#", false, false).trim();
+        if (line.isEmpty())
+            continue;
+        juce::StringArray paths;
+        paths.addTokens(line, " \t", "\"");
+        paths.removeEmptyStrings();
+        if (paths.size() != 3)
+            return file.getFileName() + ":" + juce::String(i + 1) + ": expected carrier, voice and output";
+        for (auto& path : paths)
+            path = path.unquoted();
+        jobs.push_back({directory.getChildFile(paths[0]), directory.getChildFile(paths[1]),
+                        directory.getChildFile(paths[2])});
+    }
+    return {};
+}
+
+void printUsage() {
+    std::printf("usage: prescient-render --carrier <file> --voice <file> --out <file.wav> [options]\n"
+                "       prescient-render --batch <list> [options]\n"
+                "options:\n"
+                "  --preset <file>        parameterId = value lines\n"
+                "  --<parameterId> <v>    overrides a parameter, e.g. --enableLPC 1 --modelOrder 40\n"
+                "  --jobs <n>             files rendered in parallel, default: number of cores\n"
+                "  --block <n>            samples per block, default 65536\n");
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    RenderSettings settings;
+    RenderJob single;
+    std::vector<RenderJob> jobs;
+    juce::File batchList;
+    int numThreads = static_cast<int>(std::thread::hardware_concurrency());
+    // parameters on the command line override the preset wherever they appear
+    std::vector<std::pair<juce::String, float>> overrides;
+
+    const auto cwd = juce::File::getCurrentWorkingDirectory();
+    for (int i = 1; i < argc; ++i) {
+        const juce::String option(argv[i]);
+        if (!option.startsWith("--") || i + 1 >= argc) {
+            printUsage();
+            return 1;
+        }
+        const juce::String value(argv[++i]);
+        const auto name = option.substring(2);
+        if (name == "carrier")
+            single.carrier = cwd.getChildFile(value);
+        else if (name == "voice")
+            single.voice = cwd.getChildFile(value);
+        else if (name == "out")
+            single.output = cwd.getChildFile(value);
+        else if (name == "batch")
+            batchList = cwd.getChildFile(value);
+        else if (name == "jobs")
+            numThreads = value.getIntValue();
+        else if (name == "block")
+            settings.blockSize = value.getIntValue();
+        else if (name == "preset") {
+            if (const auto error = loadPreset(settings, cwd.getChildFile(value)); error.isNotEmpty()) {
+                std::fprintf(stderr, "%s\n", error.toRawUTF8());
+                return 1;
+            }
+        }
+        else if (RenderSettings probe; setParameter(probe, name, value.getFloatValue()))
+            overrides.emplace_back(name, value.getFloatValue());
+        else {
+            std::fprintf(stderr, "unknown option: %s\n", option.toRawUTF8());
+            return 1;
+        }
+    }
+    for (const auto& [id, value] : overrides)
+        setParameter(settings, id, value);
+
+    if (batchList != juce::File()) {
+        if (const auto error = loadBatch(jobs, batchList); error.isNotEmpty()) {
+            std::fprintf(stderr, "%s\n", error.toRawUTF8());
+            return 1;
+        }
+    }
+    if (single.carrier != juce::File() || single.voice != juce::File() || single.output != juce::File()) {
+        if (single.carrier == juce::File() || single.voice == juce::File() || single.output == juce::File()) {
+            printUsage();
+            return 1;
+        }
+        jobs.push_back(single);
+    }
+    if (jobs.empty() || settings.blockSize <= 0) {
+        printUsage();
+        return 1;
+    }
+
+    // files are independent, each thread takes the next one until none are left
+    numThreads = std::clamp(numThreads, 1, static_cast<int>(jobs.size()));
+    std::atomic<size_t> nextJob{0};
+    std::atomic<int> failures{0};
+    std::mutex printLock;
+    auto renderJobs = [&] {
+        juce::AudioFormatManager formats;
+        formats.registerBasicFormats();
+        for (auto index = nextJob.fetch_add(1); index < jobs.size(); index = nextJob.fetch_add(1)) {
+            const auto& job = jobs[index];
+            double realtimeFactor = 0.0;
+            const auto error = render(job, settings, formats, realtimeFactor);
+            const std::lock_guard<std::mutex> lock(printLock);
+            if (error.isEmpty())
+                std::printf("%s: %.1fx realtime\n", job.output.getFullPathName().toRawUTF8(), realtimeFactor);
+            else {
+                std::fprintf(stderr, "%s: %s\n", job.output.getFullPathName().toRawUTF8(), error.toRawUTF8());
+                ++failures;
+            }
+        }
+    };
+    std::vector<std::thread> threads;
+    for (int thread = 1; thread < numThreads; ++thread)
+        threads.emplace_back(renderJobs);
+    renderJobs();
+    for (auto& thread : threads)
+        thread.join();
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,116 @@
+#pragma once
+#include <cmath>
+#include <complex>
+#include <limits>
+
+/**
+ * @brief Fused per-bin kernels of the phase vocoder.
+ *
+ * The loops are branch-free and work on plain arrays so that the compiler vectorizes them: selects are written as
+ * arithmetic, which compilers if-convert where they keep float ternaries as branches, and std::sqrt needs
+ * -fno-math-errno on GCC and Clang.
+ * atan2 and sin/cos are polynomial approximations: atan2 is within 1.2e-5 rad, sin and cos within 5e-7 in float.
+ */
+namespace phaseVocoderKernels {
+    constexpr float pi = 3.14159265358979f;
+    constexpr float twoPi = 2.f * pi;
+
+    /**
+     * @brief Rounds to the nearest integer, halves away from zero. Unlike std::nearbyint it needs no SSE4.1 to vectorize.
+     */
+    inline float roundNearest(float x) {
+        return static_cast<float>(static_cast<int>(x + std::copysign(0.5f, x)));
+    }
+
+    /**
+     * @brief Wraps a phase to the principal range [-pi, pi].
+     */
+    inline float wrapPhase(float phase) {
+        return phase - twoPi * roundNearest(phase * (1.f / twoPi));
+    }
+
+    /**
+     * @brief atan2 approximation, Abramowitz & Stegun 4.4.49 on the octant with range reduction.
+     */
+    inline float atan2Approx(float y, float x) {
+        const float ax = std::abs(x);
+        const float ay = std::abs(y);
+        const float mx = std::max(ax, ay);
+        const float mn = std::min(ax, ay);
+        // atan2(0, 0) is 0
+        const float a = mn / std::max(mx, std::numeric_limits<float>::min());
+        const float s = a * a;
+        float r = a * (0.9998660f + s * (-0.3302995f + s * (0.1801410f + s * (-0.0851330f + s * 0.0208351f))));
+        r += static_cast<float>(ay > ax) * (0.5f * pi - 2.f * r);
+        r += static_cast<float>(x < 0.f) * (pi - 2.f * r);
+        return std::copysign(r, y);
+    }
+
+    /**
+     * @brief sin and cos approximation: quadrant reduction and Taylor polynomials on [-pi/4, pi/4].
+     */
+    inline void sinCosApprox(float phase, float& sine, float& cosine) {
+        const float quadrant = roundNearest(phase * (2.f / pi));
+        // two-part reduction keeps the remainder accurate for the wrapped phases used here
+        const float r = (phase - quadrant * 1.5703125f) - quadrant * 4.83826794897e-4f;
+        const float r2 = r * r;
+        const float s = r * (1.f + r2 * (-1.f / 6 + r2 * (1.f / 120 + r2 * (-1.f / 5040))));
+        const float c = 1.f + r2 * (-0.5f + r2 * (1.f / 24 + r2 * (-1.f / 720 + r2 * (1.f / 40320))));
+        // the quadrant swaps and negates the polynomials, as arithmetic like the selects of atan2Approx
+        const int q = static_cast<int>(quadrant) & 3;
+        const float odd = static_cast<float>(q & 1);
+        const float swappedSine = odd * c + (1.f - odd) * s;
+        const float swappedCosine = odd * s + (1.f - odd) * c;
+        sine = swappedSine * (1.f - static_cast<float>(q & 2));
+        cosine = swappedCosine * (1.f - static_cast<float>((q + 1) & 2));
+    }
+
+    /**
+     * @brief From FFT bins to magnitude and phase increment in one pass.
+     *
+     * The increment is the deviation of the bin's phase advance from its centre frequency, wrapped, plus that frequency.
+     *
+     * @param bins The spectrum of the grain.
+     * @param omega Expected phase advance of each bin over the analysis hop.
+     * @param previousPhase Phase of each bin in the previous grain, replaced by the current phase.
+     * @param increment The phase increment of each bin.
+     * @param magnitude The magnitude of each bin, scaled by gain.
+     * @param gain Scale of the magnitudes.
+     * @param count Number of bins.
+     */
+    inline void analyzeBins(const std::complex<float>* bins, const float* omega, float* previousPhase,
+                            float* increment, float* magnitude, float gain, int count) {
+        const auto* interleaved = reinterpret_cast<const float*>(bins);
+        for (int i = 0; i < count; ++i) {
+            const float re = interleaved[2 * i];
+            const float im = interleaved[2 * i + 1];
+            const float phase = atan2Approx(im, re);
+            magnitude[i] = gain * std::sqrt(re * re + im * im);
+            increment[i] = wrapPhase(phase - previousPhase[i] - omega[i]) + omega[i];
+            previousPhase[i] = phase;
+        }
+    }
+
+    /**
+     * @brief Advances the synthesis phases and converts magnitude and phase back to bins in one pass.
+     *
+     * @param magnitude The magnitude of each bin.
+     * @param increment The phase increment of each bin over the analysis hop.
+     * @param stretch Ratio of the synthesis to the analysis hop.
+     * @param phase The synthesis phase of each bin, advanced in place.
+     * @param bins The output spectrum.
+     * @param count Number of bins.
+     */
+    inline void synthesizeBins(const float* magnitude, const float* increment, float stretch, float* phase,
+                               std::complex<float>* bins, int count) {
+        auto* interleaved = reinterpret_cast<float*>(bins);
+        for (int i = 0; i < count; ++i) {
+            const float advanced = wrapPhase(phase[i] + increment[i] * stretch);
+            phase[i] = advanced;
+            float sine, cosine;
+            sinCosApprox(advanced, sine, cosine);
+            interleaved[2 * i] = magnitude[i] * cosine;
+            interleaved[2 * i + 1] = magnitude[i] * sine;
+        }
+    }
+}
@@ -115,9 +115,38 @@ MyAudioProcessorEditor::MyAudioProcessorEditor(MyAudioProcessor &p)
 
     setResizable(false, false);
     setSize(610, 400);
+    startTimerHz(meterRateHz);
 }
 
-MyAudioProcessorEditor::~MyAudioProcessorEditor() { }
+MyAudioProcessorEditor::~MyAudioProcessorEditor() {
+    stopTimer();
+}
+
+void MyAudioProcessorEditor::timerCallback() {
+    // lock-free reads, the audio thread never waits for the GUI
+    const auto telemetry = processorRef.getTelemetry();
+    auto* stages = new juce::DynamicObject();
+    for (int i = 0; i < StageTelemetry::numProbes; ++i) {
+        const auto& summary = telemetry[static_cast<size_t>(i)];
+        if (summary.count == 0)
+            continue;
+        auto* stage = new juce::DynamicObject();
+        // the summary covers one second: time spent in percent of one core
+        stage->setProperty("load", summary.mean * static_cast<float>(summary.count) * 1e-4f);
+        stage->setProperty("mean", summary.mean);
+        stage->setProperty("p99", summary.p99);
+        stage->setProperty("max", summary.max);
+        stages->setProperty(StageTelemetry::getName(static_cast<StageTelemetry::Probe>(i)), juce::var(stage));
+    }
+
+    auto* meter = new juce::DynamicObject();
+    meter->setProperty("stages", juce::var(stages));
+    meter->setProperty("deadlineMisses", processorRef.getDeadlineMisses());
+    const double sampleRate = processorRef.getSampleRate();
+    meter->setProperty("latencyMs", sampleRate > 0.0 ? 1000.0 * processorRef.getReportedLatency() / sampleRate : 0.0);
+    meter->setProperty("worstBlockLoad", processorRef.getWorstBlockLoad());
+    webView.emitEventIfBrowserIsVisible("meter", juce::var(meter));
+}
 
 //==============================================================================
 
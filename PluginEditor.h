@@ -1,7 +1,7 @@
 #pragma once
 #include "PluginProcessor.h"
 //==============================================================================
-class MyAudioProcessorEditor final : public juce::AudioProcessorEditor
+class MyAudioProcessorEditor final : public juce::AudioProcessorEditor, private juce::Timer
 {
 public:
     explicit MyAudioProcessorEditor (MyAudioProcessor&);
@@ -13,6 +13,14 @@ private:
     using Resource = juce::WebBrowserComponent::Resource;
     static std::optional<Resource> getResource(const juce::String& url) ;
 
+    /**
+     * @brief Sends the processor's load, deadline misses and latency to the GUI as a "meter" event.
+     */
+    void timerCallback() override;
+
+    // meter updates per second, the stage timing itself changes once per second
+    static constexpr int meterRateHz = 4;
+
     MyAudioProcessor& processorRef;
 
     juce::WebSliderRelay modelOrderRelay;
@@ -16,10 +16,21 @@ MyAudioProcessor::MyAudioProcessor() :
     shiftVoice2{treeState.getRawParameterValue("shiftVoice2")},
     shiftVoice3{treeState.getRawParameterValue("shiftVoice3")},
     monostereo{treeState.getRawParameterValue("monostereo")},
-    enableLPC{treeState.getRawParameterValue("enableLPC")}
-{ }
+    enableLPC{treeState.getRawParameterValue("enableLPC")},
+    processingMode{treeState.getRawParameterValue("processingMode")},
+    synthesis{treeState.getRawParameterValue("synthesis")},
+    latencyMode{treeState.getRawParameterValue("latencyMode")},
+    overlap{treeState.getRawParameterValue("overlap")},
+    parallelChannels{treeState.getRawParameterValue("parallelChannels")},
+    envelopeReuse{treeState.getRawParameterValue("envelopeReuse")},
+    estimator{treeState.getRawParameterValue("estimator")}
+{
+    startTimerHz(latencyCheckRateHz);
+}
 
-MyAudioProcessor::~MyAudioProcessor() { }
+MyAudioProcessor::~MyAudioProcessor() {
+    stopTimer();
+}
 
 //defining parameters of the plugin
 juce::AudioProcessorValueTreeState::ParameterLayout MyAudioProcessor::createParameterLayout() {
@@ -47,6 +58,35 @@ juce::AudioProcessorValueTreeState::ParameterLayout MyAudioProcessor::createPara
     layout.add(std::make_unique<AudioParameterFloat>("monostereo", "monostereo",
            NormalisableRange<float>(0.f, 1.f, 0.01f, 1.f), 0.5f));
 
+    // 0: frames processed in the audio callback, 1: on a worker thread, 2: spread over the next hop
+    // modes 1 and 2 add one hop of latency
+    layout.add(std::make_unique<AudioParameterFloat>("processingMode", "processingMode",
+           NormalisableRange<float>(0.f, 2.f, 1.f, 1.f), 0.f));
+
+    // 0: spectral division, 1: time-domain lattice filter
+    layout.add(std::make_unique<AudioParameterFloat>("synthesis", "synthesis",
+           NormalisableRange<float>(0.f, 1.f, 1.f, 1.f), 0.f));
+
+    // analysis window 0: 1024, 1: 2048, 2: 4096 samples
+    layout.add(std::make_unique<AudioParameterFloat>("latencyMode", "latencyMode",
+           NormalisableRange<float>(0.f, 2.f, 1.f, 1.f), 1.f));
+
+    // frame overlap 0: 50%, 1: 75%, 2: 87.5%
+    layout.add(std::make_unique<AudioParameterFloat>("overlap", "overlap",
+           NormalisableRange<float>(0.f, 2.f, 1.f, 1.f), 0.f));
+
+    // 1: channels after the first are processed on worker threads while the audio thread processes the first
+    layout.add(std::make_unique<AudioParameterFloat>("parallelChannels", "parallelChannels",
+           NormalisableRange<float>(0.f, 1.f, 1.f, 1.f), 0.f));
+
+    // distance of the normalized low autocorrelation lags below which the previous envelope is kept, 0: always recompute
+    layout.add(std::make_unique<AudioParameterFloat>("envelopeReuse", "envelopeReuse",
+           NormalisableRange<float>(0.f, 0.1f, 0.001f, 1.f), 0.f));
+
+    // LPC estimator 0: autocorrelation and Levinson-Durbin, 1: Burg
+    layout.add(std::make_unique<AudioParameterFloat>("estimator", "estimator",
+           NormalisableRange<float>(0.f, 1.f, 1.f, 1.f), 0.f));
+
     return layout;
 }
 
@@ -93,32 +133,140 @@ void MyAudioProcessor::changeProgramName (int index, const juce::String& newName
 }
 
 void MyAudioProcessor::prepareToPlay (double sampleRate, int samplesPerBlock) {
-    setLatencySamples(lpcEffect[0].getLatency());
+    telemetryCollector.stop();
+    telemetryCollector.clearSources();
+    frameWorker.stop();
+    frameWorker.clearQueues();
+    for (auto& worker : channelWorkers)
+        worker->stop();
+
+    // one engine per main input channel
+    const int numChannels = getMainBusNumInputChannels();
+    // a linked frame in flight writes to the other channels' engines: it is dropped and they are unlinked before any
+    // of them is destroyed, applyProcessingSettings links the new ones
+    if (!lpcEffects.empty()) {
+        lpcEffects[0]->setLinked(false);
+        lpcEffects[0]->setFollowers({});
+    }
+    while (static_cast<int>(lpcEffects.size()) > numChannels)
+        lpcEffects.pop_back();
+    while (static_cast<int>(lpcEffects.size()) < numChannels)
+        lpcEffects.push_back(std::make_unique<LPCeffect>(static_cast<int>(sampleRate)));
+    for (auto& effect : lpcEffects) {
+        effect->prepare();
+        effect->attachWorker(frameWorker);
+    }
+    // processed in step with the first channel unless the channels run in parallel
+    std::vector<LPCeffect*> followers;
+    for (int channel = 1; channel < numChannels; ++channel)
+        followers.push_back(lpcEffects[channel].get());
+    if (numChannels > 0)
+        lpcEffects[0]->setFollowers(std::move(followers));
+    carrierPointers.resize(numChannels);
+    voicePointers.resize(numChannels);
+    outputPointers.resize(numChannels);
+
+    // the audio thread processes the first channel, the workers share the others
+    const int numTasks = std::max(0, numChannels - 1);
+    const int numWorkers = std::min(numTasks, std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1));
+    while (static_cast<int>(channelTasks.size()) < numTasks)
+        channelTasks.push_back(std::make_unique<ChannelTask>());
+    channelTasks.resize(numTasks);
+    while (static_cast<int>(channelWorkers.size()) < numWorkers)
+        channelWorkers.push_back(std::make_unique<FrameWorker>());
+    channelWorkers.resize(numWorkers);
+    for (auto& worker : channelWorkers)
+        worker->clearQueues();
+    for (int task = 0; task < numTasks; ++task)
+        channelWorkers[task % numWorkers]->addQueue(&channelTasks[task]->queue);
+
+    applyProcessingSettings();
+    setLatencySamples(reportedLatency.load(std::memory_order_relaxed));
+    // the audio thread does not wait for late frames, but a preempted worker would still miss every deadline
+    frameWorker.start(true);
+    for (auto& worker : channelWorkers)
+        worker->start(true);
+    telemetryCollector.addSource(&blockTelemetry);
+    for (auto& effect : lpcEffects)
+        telemetryCollector.addSource(&effect->getTelemetry());
+    telemetryCollector.start();
+    resetWorstBlockCost();
     juce::ignoreUnused (sampleRate, samplesPerBlock);
     juce::dsp::ProcessSpec spec{};
     spec.maximumBlockSize = samplesPerBlock;
-    spec.numChannels = 2;
+    spec.numChannels = static_cast<uint32_t>(numChannels);
     spec.sampleRate = sampleRate;
 }
 
 void MyAudioProcessor::releaseResources() {
+    telemetryCollector.stop();
+    frameWorker.stop();
+    for (auto& worker : channelWorkers)
+        worker->stop();
+}
+
+void MyAudioProcessor::applyProcessingSettings() {
+    if (lpcEffects.empty())
+        return;
+    const auto mode = static_cast<LPCeffect::ProcessingMode>(juce::roundToInt(processingMode->load()));
+    const auto windowSize = static_cast<LPCeffect::WindowSizeEnum>(juce::roundToInt(latencyMode->load()));
+    const auto frameOverlap = static_cast<LPCeffect::OverlapEnum>(juce::roundToInt(overlap->load()));
+    for (auto& effect : lpcEffects) {
+        effect->setProcessingMode(mode);
+        effect->setWindowSize(windowSize);
+        effect->setOverlap(frameOverlap);
+        effect->setWaitForLateFrames(isNonRealtime());
+    }
+    channelsInParallel = *parallelChannels > 0.99 && !channelWorkers.empty();
+    lpcEffects[0]->setLinked(!channelsInParallel);
+    // the host is told on the message thread, see timerCallback
+    reportedLatency.store(lpcEffects[0]->getLatency(), std::memory_order_relaxed);
+}
 
+void MyAudioProcessor::timerCallback() {
+    const int latency = reportedLatency.load(std::memory_order_relaxed);
+    if (latency != getLatencySamples())
+        setLatencySamples(latency);
 }
 
 bool MyAudioProcessor::isBusesLayoutSupported (const BusesLayout& layouts) const {
-    if (layouts.getMainOutputChannelSet() != juce::AudioChannelSet::mono()
-     && layouts.getMainOutputChannelSet() != juce::AudioChannelSet::stereo())
+    // any channel layout, each channel gets its own engine
+    if (layouts.getMainInputChannelSet().isDisabled())
         return false;
 
     if (layouts.getMainOutputChannelSet() != layouts.getMainInputChannelSet())
         return false;
 
+    // the sidechain may be disabled or have any number of channels, see processEffect
     return true;
 }
 
+void MyAudioProcessor::resetWorstBlockCost() {
+    worstBlockMs = 0.0;
+    worstBlockLoad = 0.0;
+}
+
 void MyAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages) {
+    // the whole callback, including the settings switches, must not touch the heap
+    ScopedNoAllocation noAllocation;
+    const auto startMs = juce::Time::getMillisecondCounterHiRes();
+    const auto blockStart = StageTelemetry::start();
+    processEffect(buffer, midiMessages);
+    blockTelemetry.record(StageTelemetry::Probe::Block, blockStart);
+
+    // cost of this block compared to the time the host has for it
+    const auto elapsedMs = juce::Time::getMillisecondCounterHiRes() - startMs;
+    const auto budgetMs = 1000.0 * buffer.getNumSamples() / getSampleRate();
+    if (elapsedMs > worstBlockMs)
+        worstBlockMs = elapsedMs;
+    if (budgetMs > 0.0 && elapsedMs / budgetMs > worstBlockLoad)
+        worstBlockLoad = elapsedMs / budgetMs;
+}
+
+void MyAudioProcessor::processEffect (juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages) {
     juce::ignoreUnused (midiMessages);
     juce::ScopedNoDenormals noDenormals;
+    applyProcessingSettings();
     auto totalNumInputChannels  = getTotalNumInputChannels();
     auto totalNumOutputChannels = getTotalNumOutputChannels();
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
@@ -127,42 +275,73 @@ void MyAudioProcessor::processBlock (juce::AudioBuffer<float>& buffer, juce::Mid
     // pointers to acquite write access to audio busses and their channels
     auto mainInput = getBusBuffer (buffer, true, 0);
     auto sideChain = getBusBuffer (buffer, true, 1);
+    const int numChannels = std::min(mainInput.getNumChannels(), static_cast<int>(lpcEffects.size()));
+    const int numSideChannels = sideChain.getNumChannels();
+    const int numSamples = buffer.getNumSamples();
 
-    auto* channelL = mainInput.getWritePointer(0);
-    auto* channelR = mainInput.getWritePointer(1);
-    auto* sideChainL = sideChain.getReadPointer(0);
-    auto* sideChainR = sideChain.getReadPointer(1);
-//    float* sideChainL;
-//    float* sideChainR;
-
-    // disable processing if no input
-    bool isSilent = true;
-    for (int sample = 0; sample < buffer.getNumSamples(); ++sample) {
-        if (std::fabs(channelL[sample]) > 0.0001f || std::fabs(channelR[sample]) > 0.0001f) {
-            isSilent = false;
-            break;
+    // silent frames are gated inside the effects, which keeps their buffers running and lets the tails out
+    if (numChannels == 0)
+        return;
+
+    const LPCeffect::Params params{static_cast<int>(*modelOrder), *shiftVoice1, *shiftVoice2, *shiftVoice3,
+                                   *enableLPC > 0.99, *passthrough,
+                                   *synthesis > 0.99 ? LPCeffect::SynthesisEngine::Lattice
+                                                     : LPCeffect::SynthesisEngine::Spectral,
+                                   *envelopeReuse,
+                                   *estimator > 0.99 ? LPCeffect::Estimator::Burg
+                                                     : LPCeffect::Estimator::Autocorrelation};
+    // channels beyond the sidechain's use its last channel; without a sidechain the input is its own voice
+    auto voiceOf = [&](int channel) {
+        return numSideChannels > 0 ? sideChain.getReadPointer(std::min(channel, numSideChannels - 1))
+                                   : mainInput.getReadPointer(channel);
+    };
+
+    // providing samples to effect chain and getting output in real-time
+    if (channelsInParallel) {
+        // the channels reach their frame boundaries on the same sample, process them concurrently
+        for (int channel = 1; channel < numChannels; ++channel) {
+            auto& task = *channelTasks[channel - 1];
+            task.effect = lpcEffects[channel].get();
+            task.carrier = mainInput.getReadPointer(channel);
+            task.voice = voiceOf(channel);
+            task.out = mainInput.getWritePointer(channel);
+            task.numSamples = numSamples;
+            task.params = params;
+            task.state.store(FrameJob::State::Queued, std::memory_order_release);
+            if (task.queue.push(&task))
+                channelWorkers[(channel - 1) % channelWorkers.size()]->notify();
         }
+        lpcEffects[0]->processBlock(mainInput.getReadPointer(0), voiceOf(0), mainInput.getWritePointer(0), numSamples, params);
+        // channels the workers have not picked up yet are processed here
+        for (int channel = 1; channel < numChannels; ++channel)
+            channelTasks[channel - 1]->complete();
     }
-    if (isSilent)
-        return;
+    else {
+        // in step, so that channels with the same voice or carrier share the analysis
+        for (int channel = 0; channel < numChannels; ++channel) {
+            carrierPointers[channel] = mainInput.getReadPointer(channel);
+            voicePointers[channel] = voiceOf(channel);
+            outputPointers[channel] = mainInput.getWritePointer(channel);
+        }
+        lpcEffects[0]->processLinkedBlock(carrierPointers.data(), voicePointers.data(), outputPointers.data(),
+                                          numChannels, numSamples, params);
+    }
+    int misses = 0;
+    for (const auto& effect : lpcEffects)
+        misses += effect->getDeadlineMisses();
+    deadlineMisses.store(misses, std::memory_order_relaxed);
 
-    for (int sample = 0; sample < buffer.getNumSamples(); ++sample) {
-        float sampleL = channelL[sample];
-        float sampleR = channelR[sample];
-        // providing samples to effect chain and getting output in real-time
-        sampleL = lpcEffect[0].sendSample(sampleL, sideChainL[sample], *modelOrder,
-                                          *shiftVoice1, *shiftVoice2, *shiftVoice3, *enableLPC > 0.99, *passthrough);
-        sampleR = lpcEffect[1].sendSample(sampleR, sideChainR[sample], *modelOrder,
-                                          *shiftVoice1, *shiftVoice2, *shiftVoice3, *enableLPC > 0.99, *passthrough);
-        // midside processing for stereo limiting
-        float width = *monostereo;
-        auto sideNew = width * 0.5 * (sampleL - sampleR);
-        auto midNew = (2 - width) * 0.5 * (sampleL + sampleR);
-        sampleL = static_cast<float>(midNew + sideNew);
-        sampleR = static_cast<float>(midNew - sideNew);
-
-        channelL[sample] = sampleL;
-        channelR[sample] = sampleR;
+    // midside processing for stereo limiting, on the front left and right pair
+    if (numChannels < 2)
+        return;
+    auto* channelL = mainInput.getWritePointer(0);
+    auto* channelR = mainInput.getWritePointer(1);
+    const float width = *monostereo;
+    for (int sample = 0; sample < numSamples; ++sample) {
+        const float side = width * 0.5f * (channelL[sample] - channelR[sample]);
+        const float mid = (2 - width) * 0.5f * (channelL[sample] + channelR[sample]);
+        channelL[sample] = mid + side;
+        channelR[sample] = mid - side;
     }
 }
 
@@ -3,8 +3,11 @@
 #include <juce_audio_processors/juce_audio_processors.h>
 #include <juce_dsp/juce_dsp.h>
 #include "LPCeffect.h"
+#include <memory>
+#include <thread>
+#include <vector>
 //==============================================================================
-class MyAudioProcessor final : public juce::AudioProcessor {
+class MyAudioProcessor final : public juce::AudioProcessor, private juce::Timer {
 public:
     MyAudioProcessor();
     ~MyAudioProcessor() override;
@@ -37,6 +40,45 @@ public:
     void setStateInformation (const void* data, int sizeInBytes) override;
 
     static juce::AudioProcessorValueTreeState::ParameterLayout createParameterLayout();
+
+    /**
+     * @brief Longest processBlock call since the last reset, in milliseconds.
+     */
+    [[nodiscard]] double getWorstBlockMs() const {
+        return worstBlockMs;
+    }
+
+    /**
+     * @brief Highest ratio of processBlock time to the block's duration since the last reset. Above 1 means a dropout.
+     */
+    [[nodiscard]] double getWorstBlockLoad() const {
+        return worstBlockLoad;
+    }
+
+    void resetWorstBlockCost();
+
+    /**
+     * @brief Frames of all channels the worker did not finish within one hop, since the effects were created.
+     */
+    [[nodiscard]] int getDeadlineMisses() const {
+        return deadlineMisses.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Latency of the current processing settings, in samples. The host is told on the message thread.
+     */
+    [[nodiscard]] int getReportedLatency() const {
+        return reportedLatency.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Stage and block timing over the last second, in microseconds. Lock-free, all zero unless built with
+     * PRESCIENT_TELEMETRY.
+     */
+    [[nodiscard]] TelemetryCollector::Snapshot getTelemetry() const {
+        return telemetryCollector.getSnapshot();
+    }
+
     juce::AudioProcessorValueTreeState treeState;
 
 private:
@@ -47,6 +89,34 @@ private:
     std::atomic<float>* shiftVoice3{nullptr};
     std::atomic<float>* monostereo{nullptr};
     std::atomic<float>* enableLPC{nullptr};
+    std::atomic<float>* processingMode{nullptr};
+    std::atomic<float>* synthesis{nullptr};
+    std::atomic<float>* latencyMode{nullptr};
+    std::atomic<float>* overlap{nullptr};
+    std::atomic<float>* parallelChannels{nullptr};
+    std::atomic<float>* envelopeReuse{nullptr};
+    std::atomic<float>* estimator{nullptr};
+
+    /**
+     * @brief Applies the processingMode, latencyMode, overlap and parallelChannels parameters to the effect instances
+     * and publishes the resulting latency. Runs inside the audio callback's no-allocation scope, the switches only
+     * resize within the capacity reserved in prepareToPlay.
+     */
+    void applyProcessingSettings();
+
+    /**
+     * @brief Reports a latency changed by a switch in the audio callback to the host. setLatencySamples notifies the
+     * host synchronously, which may lock or allocate, so the audio thread only publishes it.
+     */
+    void timerCallback() override;
+    void processEffect(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages);
+
+    std::atomic<double> worstBlockMs{0.0};
+    std::atomic<double> worstBlockLoad{0.0};
+    // for the GUI, which must not touch the effects
+    std::atomic<int> deadlineMisses{0};
+    std::atomic<int> reportedLatency{0};
+    static constexpr int latencyCheckRateHz = 20;
 
     template<int Index, typename ChainType, typename CoefficientType>
     void update(ChainType& chain, const CoefficientType& coefficients) {
@@ -54,10 +124,40 @@ private:
         chain.template setBypassed<Index>(false);
     }
 
-    LPCeffect lpcEffect[2] = {
-            LPCeffect(static_cast<int>(getSampleRate())),
-            LPCeffect(static_cast<int>(getSampleRate()))
+    // one engine per main input channel, created in prepareToPlay
+    std::vector<std::unique_ptr<LPCeffect>> lpcEffects;
+
+    /**
+     * @brief One channel's block, processed on a channel worker while the audio thread processes the first channel.
+     */
+    struct ChannelTask final : FrameJob {
+        void render() override {
+            effect->processBlock(carrier, voice, out, numSamples, params);
+        }
+
+        LPCeffect* effect = nullptr;
+        const float* carrier = nullptr;
+        const float* voice = nullptr;
+        float* out = nullptr;
+        int numSamples = 0;
+        LPCeffect::Params params;
+        FrameWorker::Queue queue;
     };
+    // a task per channel after the first, spread over the channel workers
+    std::vector<std::unique_ptr<ChannelTask>> channelTasks;
+    // the channels of the block, processed in step when not in parallel
+    std::vector<const float*> carrierPointers;
+    std::vector<const float*> voicePointers;
+    std::vector<float*> outputPointers;
+    // the channels run concurrently on the channel workers rather than in step, set with the other processing settings
+    bool channelsInParallel = false;
+
+    // declared after the effects and tasks so that they stop before those are destroyed
+    FrameWorker frameWorker;
+    std::vector<std::unique_ptr<FrameWorker>> channelWorkers;
+    // timing of processBlock and of the effects' stages, drained by the collector
+    StageTelemetry blockTelemetry;
+    TelemetryCollector telemetryCollector;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (MyAudioProcessor)
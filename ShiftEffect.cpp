@@ -1,118 +1,217 @@
 #include "ShiftEffect.h"
+#include "PhaseVocoderKernels.h"
 #include <iostream>
 #include <fstream>
+#include <limits>
 
 ShiftEffect::ShiftEffect(const int sampleRate) {
-    LEN = 1024;
-    synthesisHop = 250;
     windowLenEnum = WindowLenEnum::M;
+}
+
+void ShiftEffect::prepare(int maxInputLength) {
+    // plans for every grain length and storage for the longest, so that switching does not allocate
+    const int maxLEN = static_cast<int>(hannWindowL.size());
+    size_t tempSize = 0;
+    for (auto length : {WindowLenEnum::S, WindowLenEnum::M, WindowLenEnum::L}) {
+        const auto i = static_cast<size_t>(length);
+        grainPlans[i] = std::make_unique<dft_plan_real<float>>(hannWindow[length].size());
+        tempSize = std::max(tempSize, grainPlans[i]->temp_size);
+    }
+    grainTemp.resize(tempSize);
+
+    // the longest resampled grain belongs to the lowest shift ratio
+    const int maxResampledLEN = static_cast<int>(maxLEN / minShift);
+    overLapOut.resize(maxInputLength + maxResampledLEN);
+
+    for (auto* buffer : {&grain, &grainWindow, &omega, &previousPhi, &delta, &magnitude})
+        buffer->reserve(maxLEN);
+    for (auto& voice : voices) {
+        voice.psi.reserve(maxLEN);
+        voice.resampleIndex.reserve(maxResampledLEN);
+    }
+    for (auto* buffer : {&fftGrain, &corrected})
+        buffer->reserve(maxLEN);
+    configureGrains();
+}
+
+void ShiftEffect::setWindowLength(WindowLenEnum length) {
+    if (length == windowLenEnum)
+        return;
+    windowLenEnum = length;
+    configureGrains();
+}
+
+int ShiftEffect::synthesisHopFor(int grainLength) {
+    // a quarter of the grain, as 250 for the 1024 grain
+    return grainLength * 250 / 1024;
+}
+
+void ShiftEffect::configureGrains() {
+    LEN = static_cast<int>(hannWindow[windowLenEnum].size());
+    synthesisHop = synthesisHopFor(LEN);
     jassert(LEN % 2 == 0);
-    psi.resize(LEN, 0.f);
-    ramp.resize(LEN, 0.f);
-    omega.resize(LEN, 0.f);
-    fftGrain.resize(LEN / 2 + 1, 0.f);
-    phi.resize(LEN, 0.f);
-    previousPhi.resize(LEN, 0.f);
-    delta.resize(LEN, 0.f);
-    f1.resize(LEN, 0.f);
-    corrected.resize(LEN, 0.f);
+
+    // within the capacity reserved in prepare, the phase state restarts
+    for (auto* buffer : {&grain, &grainWindow, &omega, &previousPhi, &delta, &magnitude}) {
+        buffer->resize(LEN);
+        std::fill(buffer->begin(), buffer->end(), 0.f);
+    }
+    for (auto& voice : voices) {
+        voice.psi.resize(LEN);
+        std::fill(voice.psi.begin(), voice.psi.end(), 0.f);
+        voice.tableKey = -1;
+    }
+    omegaHop = -1;
+    for (auto* buffer : {&fftGrain, &corrected})
+        buffer->resize(LEN);
+    const auto& window = hannWindow[windowLenEnum];
+    std::copy(window.begin(), window.end(), grainWindow.begin());
+    grainPlan = grainPlans[static_cast<size_t>(windowLenEnum)].get();
+
+    // magnitude sum of the window spectrum as the real inverse transform weighs it, fftGrain is free here
+    padFFT(grainWindow, fftGrain);
+    windowMagnitudeSum = 0.f;
+    for (int i = 0; i <= LEN / 2; ++i)
+        windowMagnitudeSum += (i == 0 || i == LEN / 2 ? 1.f : 2.f) * std::abs(fftGrain[i]) / static_cast<float>(LEN);
 }
 
 univector<float> ShiftEffect::shiftSignal(const univector<float>& input, float shift) {
-    univector<float> finalOutput(input.size(), 0.f);
-    int analysisHop = static_cast<int>(synthesisHop / shift);
-    const int resampledLEN = std::floor(LEN * analysisHop / synthesisHop);
-
-    std::iota(ramp.begin(), ramp.end(), 1);
-    std::transform(ramp.begin(), ramp.end(), ramp.begin(), [&](int i) {
-        return std::floor((i * analysisHop) / synthesisHop) + 1;
-    });
-
-    univector<float> x(resampledLEN, 0.f);
-    for (int i = 0; i < resampledLEN; ++i)
-        x[i] = (1 + (float) i * LEN / resampledLEN);
-
-    for (int i = 0; i < LEN; ++i)
-        omega[i] = 2 * pi * analysisHop * i / LEN;
-
-    univector<float> overLapOut(input.size() + resampledLEN, 0.f);
-    univector<float> grain(LEN);
-    int endCycle = std::floor(input.size() - std::max(LEN, ramp[LEN - 1]));
-    for (int anCycle = 0; anCycle < endCycle; anCycle += analysisHop) {
-        std::copy(input.begin() + anCycle, input.begin() + anCycle + LEN, grain.begin());
-        mulVectorWith(grain, hannWindow[windowLenEnum]);
-        fftGrain = padFFT(grain);
-
-        // phase information: output psi
-        phi = carg(fftGrain);
-        delta = modulo(phi - previousPhi - omega + pi, -2 * pi) + omega + pi;
-        psi = modulo(psi + delta * synthesisHop / analysisHop + pi, -2 * pi) + pi;
-        previousPhi = phi;
-
-        // shifting: output correction factor
-        f1 = absOf(padFFT(mul(input[anCycle], hannWindow[windowLenEnum])) / LEN);
-        corrected = mul(absOf(fftGrain), std::exp(cutIFFT(f1 - fftGrain)[0]));
-        mulVectorWith(corrected, expComplex(makeComplex(psi)));
-
-        // overlap
-        grain = real(cutIFFT(corrected));
-        mulVectorWith(grain, hannWindow[windowLenEnum]);
-        for (int ai = anCycle; ai < anCycle + resampledLEN; ++ai)
-            overLapOut[ai] += grain[std::floor(x[ai - anCycle]) - 1];
+    const float shifts[] = {shift};
+    beginShift(input, shifts);
+    while (!shiftGrains(std::numeric_limits<int>::max()));
+    univector<float> output(input.size());
+    copyShifted(output);
+    return output;
+}
+
+void ShiftEffect::prepareVoice(Voice& voice, float shift) const {
+    // ratios are quantized to the parameter step, the tables are rebuilt only when the ratio changes
+    const int key = static_cast<int>(std::lround(shift / shiftStep));
+    if (key == voice.tableKey)
+        return;
+    voice.tableKey = key;
+    voice.shift = static_cast<float>(key) * shiftStep;
+    // the grain is stretched by the shift and resampled back, then overlapped at the analysis hop
+    voice.resampledLEN = static_cast<int>(LEN / voice.shift);
+    voice.resampleIndex.resize(voice.resampledLEN);
+    for (int i = 0; i < voice.resampledLEN; ++i)
+        voice.resampleIndex[i] = (i * LEN) / voice.resampledLEN;
+}
+
+int ShiftEffect::sharedAnalysisHop(std::span<const float> shifts) const {
+    // the highest shift needs the finest hop, the other voices get more overlap than they need
+    float maxShift = 0.f;
+    for (float shift : shifts)
+        if (shift > 0.f)
+            maxShift = std::max(maxShift, std::max(shift, minShift));
+    return maxShift > 0.f ? static_cast<int>(synthesisHop / maxShift) : 0;
+}
+
+void ShiftEffect::beginShift(std::span<const float> input, std::span<const float> shifts) {
+    jassert(static_cast<int>(shifts.size()) <= maxVoices);
+    shiftInput = input;
+    analysisHop = sharedAnalysisHop(shifts);
+    anCycle = 0;
+    endCycle = 0;
+    numActive = 0;
+    int maxResampledLEN = 0;
+
+    for (int v = 0; v < static_cast<int>(shifts.size()); ++v) {
+        if (shifts[v] <= 0.f)
+            continue;
+        jassert(shifts[v] >= minShift);
+        Voice& voice = voices[v];
+        prepareVoice(voice, std::max(shifts[v], minShift));
+        voice.endCycle = static_cast<int>(input.size()) - std::max(LEN, voice.resampledLEN + 1);
+        // the overlap of the resampled grains grows as the shift falls below the highest one
+        voice.gain = static_cast<float>(analysisHop) * voice.shift / static_cast<float>(synthesisHop);
+        activeVoices[numActive++] = v;
+        endCycle = std::max(endCycle, voice.endCycle);
+        maxResampledLEN = std::max(maxResampledLEN, voice.resampledLEN);
+    }
+
+    // expected phase advance of each bin, depends on the hop only
+    if (analysisHop != omegaHop) {
+        for (int i = 0; i < LEN; ++i)
+            omega[i] = 2 * pi * analysisHop * i / LEN;
+        omegaHop = analysisHop;
     }
-    return {overLapOut.begin(), overLapOut.begin() + input.size()};
+
+    jassert(input.size() + maxResampledLEN <= overLapOut.size());
+    std::fill(overLapOut.begin(), overLapOut.begin() + input.size() + maxResampledLEN, 0.f);
 }
 
-void ShiftEffect::mulVectorWith(univector<float>& vec1, const univector<float>& vec2) {
-    std::transform(vec1.begin(), vec1.end(), vec2.begin(), vec1.begin(), std::multiplies<>());
+bool ShiftEffect::shiftGrains(int maxGrains) {
+    const std::span<const float> input = shiftInput;
+    for (int g = 0; g < maxGrains && anCycle < endCycle; ++g, anCycle += analysisHop) {
+        std::copy(input.begin() + anCycle, input.begin() + anCycle + LEN, grain.begin());
+        mulVectorWith(grain, grainWindow);
+        padFFT(grain, fftGrain);
+
+        // shifting: output correction factor, shared by the voices. It is the first cepstrum coefficient of
+        // |FFT(grainStart * window)| / LEN - FFT(grain), the sum over the spectrum: the window part is the
+        // precomputed magnitude sum scaled by |grainStart|, the grain part is LEN times its first sample
+        const float grainStart = input[anCycle];
+        const float correction = std::exp(std::abs(grainStart) * windowMagnitudeSum - static_cast<float>(LEN) * grain[0]);
+
+        // phase information, shared by the voices: corrected magnitude and phase advance over the analysis hop.
+        // The inverse real transform only reads the non-negative frequencies, the other half is not computed
+        const int bins = LEN / 2 + 1;
+        phaseVocoderKernels::analyzeBins(fftGrain.data(), omega.data(), previousPhi.data(), delta.data(),
+                                         magnitude.data(), correction, bins);
+
+        // per voice: phase propagation, synthesis and overlap
+        for (int a = 0; a < numActive; ++a) {
+            Voice& voice = voices[activeVoices[a]];
+            if (anCycle >= voice.endCycle)
+                continue;
+            phaseVocoderKernels::synthesizeBins(magnitude.data(), delta.data(), voice.shift, voice.psi.data(),
+                                                corrected.data(), bins);
+            cutIFFT(corrected, grain);
+            mulVectorWith(grain, grainWindow);
+            for (int i = 0; i < voice.resampledLEN; ++i)
+                overLapOut[anCycle + i] += voice.gain * grain[voice.resampleIndex[i]];
+        }
+    }
+    return anCycle >= endCycle;
 }
 
-void ShiftEffect::mulVectorWith(univector<std::complex<float>>& vec1, const univector<std::complex<float>>& vec2) {
-    std::transform(vec1.begin(), vec1.end(), vec2.begin(), vec1.begin(), std::multiplies<>());
+void ShiftEffect::copyShifted(univector<float>& output) const {
+    std::copy(overLapOut.begin(), overLapOut.begin() + shiftInput.size(), output.begin());
 }
 
-univector<float> ShiftEffect::absOf(const univector<std::complex<float>>& ofBuffer) {
-    univector<float> result(ofBuffer.size());
-    std::transform(ofBuffer.begin(), ofBuffer.end(), result.begin(),
-                   [](const std::complex<float>& x) { return std::abs(x); });
-    return result;
+void ShiftEffect::addShifted(univector<float>& output) const {
+    std::transform(output.begin(), output.end(), overLapOut.begin(), output.begin(), std::plus<>());
 }
 
-univector<std::complex<float>> ShiftEffect::makeComplex(const univector<float>& ofBuffer) {
-    univector<std::complex<float>> result;
-    result.reserve(ofBuffer.size());
-    std::transform(ofBuffer.begin(), ofBuffer.end(), std::back_inserter(result), [](float x) {
-        return std::complex<float>(0.f, x);
-    });
-    return result;
+int ShiftEffect::grainCount(int inputLength, std::span<const float> shifts) const {
+    const int hop = sharedAnalysisHop(shifts);
+    int end = 0;
+    for (float shift : shifts) {
+        if (shift <= 0.f)
+            continue;
+        // the resampled grain length of the ratio as prepareVoice quantizes it
+        const float quantized = static_cast<float>(std::lround(std::max(shift, minShift) / shiftStep)) * shiftStep;
+        end = std::max(end, inputLength - std::max(LEN, static_cast<int>(LEN / quantized) + 1));
+    }
+    return end > 0 ? (end + hop - 1) / hop : 0;
 }
 
-univector<std::complex<float>> ShiftEffect::expComplex(const univector<std::complex<float>>& ofBuffer) {
-    univector<std::complex<float>> result;
-    result.reserve(ofBuffer.size());
-    std::transform(ofBuffer.begin(), ofBuffer.end(), std::back_inserter(result), [](const std::complex<float>& x) {
-        return std::exp(x);
-    });
-    return result;
+void ShiftEffect::mulVectorWith(univector<float>& vec1, const univector<float>& vec2) {
+    std::transform(vec1.begin(), vec1.end(), vec2.begin(), vec1.begin(), std::multiplies<>());
 }
 
-univector<float> ShiftEffect::modulo(const univector<float>& a, float b) {
-    univector<float> result(a.size());
-    std::transform(a.begin(), a.end(), result.begin(),
-                   [b](float x) { return std::fmod(x, b); });
-    return result;
+void ShiftEffect::mulVectorWith(univector<std::complex<float>>& vec1, const univector<std::complex<float>>& vec2) {
+    std::transform(vec1.begin(), vec1.end(), vec2.begin(), vec1.begin(), std::multiplies<>());
 }
 
 /** FFT and filling the other half with zeroes */
-univector<std::complex<float>> ShiftEffect::padFFT(const univector<float>& input) const {
-    univector<std::complex<float>> buff = realdft(input);
-    univector<std::complex<float>> result(LEN, 0.f);
-    std::copy(buff.begin(), buff.end(), result.begin());
-    return result;
+void ShiftEffect::padFFT(const univector<float>& input, univector<std::complex<float>>& output) {
+    grainPlan->execute(output.data(), input.data(), grainTemp.data());
+    std::fill(output.begin() + LEN / 2 + 1, output.end(), 0.f);
 }
 
 /** cutting the other half (of zeroes) and IFFT */
-univector<float> ShiftEffect::cutIFFT(const univector<std::complex<float>>& input) {
-    univector<std::complex<float>> buff(input.begin(), input.begin() + input.size() / 2 + 1);
-    return irealdft(buff);
-}
\ No newline at end of file
+void ShiftEffect::cutIFFT(const univector<std::complex<float>>& input, univector<float>& output) {
+    grainPlan->execute(output.data(), input.data(), grainTemp.data());
+}
@@ -1,4 +1,6 @@
 #pragma once
+#include <array>
+#include <span>
 using namespace kfr;
 
 class ShiftEffect {
@@ -6,7 +8,28 @@ public:
     inline explicit ShiftEffect(const int sampleRate);
 
     /**
-     * @brief Shifts the input signal by the ratio.
+     * @brief Allocates the grain FFT plan and all working buffers. Must be called before shifting, off the audio thread.
+     *
+     * @param maxInputLength Length of the longest signal that will be shifted.
+     */
+    inline void prepare(int maxInputLength);
+
+    /**
+     * @brief Grain lengths: 512, 1024 and 2048 samples.
+     */
+    enum class WindowLenEnum {
+        S, M, L
+    };
+
+    /**
+     * @brief Switches the grain length. Restarts the phase state, does not allocate.
+     *
+     * @param length The new grain length.
+     */
+    inline void setWindowLength(WindowLenEnum length);
+
+    /**
+     * @brief Shifts the input signal by the ratio. Allocates the result, not meant for the audio thread.
      *
      * @param input The input signal.
      * @param shift Shift ratio.
@@ -15,56 +38,93 @@ public:
      */
     inline univector<float> shiftSignal(const univector<float>& input, float shift);
 
-private:
-    inline static void mulVectorWith(univector<float>& vec1, const univector<float>& vec2);
-    inline static void mulVectorWith(univector<std::complex<float>>& vec1, const univector<std::complex<float>>& vec2);
-    inline static univector<float> absOf(const univector<std::complex<float>>& ofBuffer);
+    /** Number of voices shifted together, each keeps its own phase state. */
+    static constexpr int maxVoices = 3;
+
+    /**
+     * @brief Prepares shifting of the input signal by up to maxVoices ratios at once. The grains are then processed by shiftGrains.
+     *
+     * The voices share the grain analysis, only phase propagation and synthesis run per voice.
+     *
+     * @param input The input signal, must stay valid until the shift is finished.
+     * @param shifts Shift ratio of each voice, a ratio of 0 leaves the voice out.
+     */
+    inline void beginShift(std::span<const float> input, std::span<const float> shifts);
+
+    /**
+     * @brief Processes the next grains of the signal prepared by beginShift.
+     *
+     * @param maxGrains Maximum number of grains to process.
+     *
+     * @return True once the whole signal is shifted.
+     */
+    inline bool shiftGrains(int maxGrains);
+
+    /**
+     * @brief Copies the sum of the shifted voices to the output, valid once shiftGrains returned true.
+     *
+     * @param output Buffer of the input signal's length.
+     */
+    inline void copyShifted(univector<float>& output) const;
 
     /**
-     * @brief Converts a real-valued buffer to a complex buffer.
+     * @brief Adds the sum of the shifted voices to the output, valid once shiftGrains returned true.
      *
-     * @param ofBuffer The real-valued buffer.
+     * @param output Buffer of the input signal's length.
+     */
+    inline void addShifted(univector<float>& output) const;
+
+    /** The lowest shift ratio, sizes the working buffers. */
+    static constexpr float minShift = 0.6f;
+
+    /**
+     * @brief Number of grains shifting a signal takes.
      *
-     * @return The complex buffer.
+     * @param inputLength Length of the input signal.
+     * @param shifts Shift ratio of each voice, as for beginShift.
+     *
+     * @return The grain count.
+     */
+    [[nodiscard]] inline int grainCount(int inputLength, std::span<const float> shifts) const;
+
+private:
+    /**
+     * @brief Sizes the buffers, hop and plan for the current grain length.
      */
-    inline static univector<std::complex<float>> makeComplex(const univector<float>& ofBuffer);
+    inline void configureGrains();
 
     /**
-      * @brief Applies the exponential function element-wise to a complex buffer.
-      *
-      * @param ofBuffer The input complex buffer.
-      *
-      * @return Element-wise exponentials of the input complex numbers.
-      */
-    inline static univector<std::complex<float>> expComplex(const univector<std::complex<float>>& ofBuffer);
+     * @brief Synthesis hop used with a grain length.
+     */
+    inline static int synthesisHopFor(int grainLength);
 
     /**
-    * @brief Modulo of a buffer with a scalar value.
-    *
-    * @param a The buffer to compute the modulo of.
-    * @param b The modulus.
-    *
-    * @return Modulo-ed buffer.
-    */
-    inline static univector<float> modulo(const univector<float>& a, float b);
+     * @brief Analysis hop shared by the voices: the one the highest shift ratio needs.
+     *
+     * @param shifts Shift ratio of each voice, as for beginShift.
+     *
+     * @return The hop, 0 without any voice.
+     */
+    [[nodiscard]] inline int sharedAnalysisHop(std::span<const float> shifts) const;
+
+    inline static void mulVectorWith(univector<float>& vec1, const univector<float>& vec2);
+    inline static void mulVectorWith(univector<std::complex<float>>& vec1, const univector<std::complex<float>>& vec2);
 
     /**
         * @brief FFT transform and filling the other half with zeroes.
         *
         * @param input The input signal.
-        *
-        * @return The output frequency domain coefficients.
+        * @param output The output frequency domain coefficients.
         */
-    inline univector<std::complex<float>> padFFT(const univector<float>& input) const;
+    inline void padFFT(const univector<float>& input, univector<std::complex<float>>& output);
 
     /**
        * @brief Cutting the other half (of zeroes) before performing IFFT.
        *
        * @param input The input frequency domain coefficients.
-       *
-       * @return A real-valued signal.
+       * @param output A real-valued signal.
        */
-    inline static univector<float> cutIFFT(const univector<std::complex<float>>& input) ;
+    inline void cutIFFT(const univector<std::complex<float>>& input, univector<float>& output);
 
     const float pi = 2 * acos(0.0);
     int LEN = 0;
@@ -73,9 +133,6 @@ private:
     univector<fbase, 2048> hannWindowL = window_hann(2048);
     int synthesisHop = 0;
 
-    enum class WindowLenEnum {
-        S, M, L
-    };
     WindowLenEnum windowLenEnum;
 
     std::unordered_map<WindowLenEnum, univector<fbase>> hannWindow = {
@@ -84,13 +141,52 @@ private:
             {WindowLenEnum::L, hannWindowL}
     };
 
-    univector<float> psi;
-    univector<int> ramp;
+    // phase state and resampling of one voice
+    struct Voice {
+        float shift = 1.f;
+        float gain = 1.f;
+        int resampledLEN = 0;
+        int endCycle = 0;
+        univector<float> psi;
+        // grain sample of each resampled sample, for the quantized ratio tableKey
+        univector<int> resampleIndex;
+        int tableKey = -1;
+    };
+
+    /**
+     * @brief Sets the voice's ratio, quantized to shiftStep, and rebuilds its resampling table if the ratio changed.
+     *
+     * @param voice The voice.
+     * @param shift Shift ratio.
+     */
+    inline void prepareVoice(Voice& voice, float shift) const;
+
+    /** Step of the shift parameters, ratios are quantized to it. */
+    static constexpr float shiftStep = 0.01f;
+    std::array<Voice, maxVoices> voices;
+    std::array<int, maxVoices> activeVoices{};
+    int numActive = 0;
+
+    std::span<const float> shiftInput;
+    int analysisHop = 0;
+    int anCycle = 0;
+    int endCycle = 0;
+    univector<float> overLapOut;
+    univector<float> grain;
+
+    univector<float> grainWindow;
     univector<float> omega;
     univector<std::complex<float>> fftGrain;
-    univector<float> phi;
     univector<float> previousPhi;
     univector<float> delta;
-    univector<float> f1;
+    univector<float> magnitude;
     univector<std::complex<float>> corrected;
+    // hop omega was computed for
+    int omegaHop = -1;
+    float windowMagnitudeSum = 0.f;
+
+    // grain FFT plans for every length, the one in use and its workspaces, created in prepare
+    std::array<std::unique_ptr<dft_plan_real<float>>, 3> grainPlans;
+    dft_plan_real<float>* grainPlan = nullptr;
+    univector<u8> grainTemp;
 };
\ No newline at end of file
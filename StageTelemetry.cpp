@@ -0,0 +1,172 @@
+#include "StageTelemetry.h"
+#include <algorithm>
+#include <cmath>
+
+const char* StageTelemetry::getName(Probe probe) {
+    switch (probe) {
+        case Probe::ShiftVoices:
+            return "shiftVoices";
+        case Probe::MatchShifted:
+            return "matchShifted";
+        case Probe::VoiceAnalysis:
+            return "voiceAnalysis";
+        case Probe::CarrierResiduals:
+            return "carrierResiduals";
+        case Probe::Synthesis:
+            return "synthesis";
+        case Probe::Mix:
+            return "mix";
+        case Probe::Frame:
+            return "frame";
+        case Probe::Block:
+            return "block";
+    }
+    return "";
+}
+
+#if PRESCIENT_TELEMETRY
+void StageTelemetry::record(Probe probe, TimePoint start) {
+    const std::chrono::duration<float, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    samples.push({probe, elapsed.count()});
+}
+
+void StageTelemetry::addStage(Probe probe, TimePoint start) {
+    frameTimes[static_cast<size_t>(probe)] += std::chrono::steady_clock::now() - start;
+}
+
+void StageTelemetry::endFrame() {
+    std::chrono::steady_clock::duration frame{};
+    for (int i = 0; i < static_cast<int>(Probe::Frame); ++i) {
+        // stages the frame skipped are not recorded
+        if (frameTimes[i].count() == 0)
+            continue;
+        frame += frameTimes[i];
+        samples.push({static_cast<Probe>(i), std::chrono::duration<float, std::micro>(frameTimes[i]).count()});
+        frameTimes[i] = {};
+    }
+    samples.push({Probe::Frame, std::chrono::duration<float, std::micro>(frame).count()});
+}
+#endif
+
+TelemetryCollector::~TelemetryCollector() {
+    stop();
+}
+
+#if PRESCIENT_TELEMETRY
+void TelemetryCollector::addSource(StageTelemetry* source) {
+    jassert(!running);
+    sources.push_back(source);
+}
+
+void TelemetryCollector::clearSources() {
+    jassert(!running);
+    sources.clear();
+}
+
+void TelemetryCollector::start() {
+    if (running)
+        return;
+    running = true;
+    thread = std::thread([this] { run(); });
+}
+
+void TelemetryCollector::stop() {
+    {
+        const std::lock_guard<std::mutex> lock(wakeLock);
+        if (!running)
+            return;
+        running = false;
+    }
+    wake.notify_one();
+    thread.join();
+}
+
+TelemetryCollector::Snapshot TelemetryCollector::getSnapshot() const {
+    Snapshot snapshot;
+    for (;;) {
+        const auto before = version.load(std::memory_order_acquire);
+        if (before % 2 == 0) {
+            for (size_t i = 0; i < snapshot.size(); ++i) {
+                const auto& summary = published[i];
+                snapshot[i] = {summary.count.load(std::memory_order_relaxed), summary.min.load(std::memory_order_relaxed),
+                               summary.mean.load(std::memory_order_relaxed), summary.p99.load(std::memory_order_relaxed),
+                               summary.max.load(std::memory_order_relaxed)};
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (version.load(std::memory_order_relaxed) == before)
+                return snapshot;
+        }
+        std::this_thread::yield();
+    }
+}
+
+void TelemetryCollector::run() {
+    std::unique_lock<std::mutex> lock(wakeLock);
+    int drains = 0;
+    while (running) {
+        wake.wait_for(lock, drainInterval);
+        drain();
+        if (++drains == drainsPerSummary) {
+            publish();
+            drains = 0;
+        }
+    }
+}
+
+void TelemetryCollector::drain() {
+    StageTelemetry::Sample sample;
+    for (auto* source : sources) {
+        while (source->pop(sample)) {
+            auto& histogram = histograms[static_cast<size_t>(sample.probe)];
+            const float microseconds = sample.microseconds;
+            const int bin = microseconds > firstBin
+                                ? static_cast<int>(binsPerOctave * std::log2(microseconds / firstBin))
+                                : 0;
+            ++histogram.bins[std::min(bin, numBins - 1)];
+            histogram.min = histogram.count == 0 ? microseconds : std::min(histogram.min, microseconds);
+            histogram.max = histogram.count == 0 ? microseconds : std::max(histogram.max, microseconds);
+            histogram.sum += microseconds;
+            ++histogram.count;
+        }
+    }
+}
+
+void TelemetryCollector::publish() {
+    version.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < histograms.size(); ++i) {
+        auto& histogram = histograms[i];
+        auto& summary = published[i];
+        // upper edge of the bin the 99th percentile falls in, at most the largest duration
+        float p99 = histogram.max;
+        int below = 0;
+        for (int bin = 0; bin < numBins; ++bin) {
+            below += histogram.bins[bin];
+            if (below * 100 >= histogram.count * 99) {
+                p99 = std::min(histogram.max, firstBin * std::exp2(static_cast<float>(bin + 1) / binsPerOctave));
+                break;
+            }
+        }
+        summary.count.store(histogram.count, std::memory_order_relaxed);
+        summary.min.store(histogram.min, std::memory_order_relaxed);
+        summary.mean.store(histogram.count > 0 ? static_cast<float>(histogram.sum / histogram.count) : 0.f,
+                           std::memory_order_relaxed);
+        summary.p99.store(histogram.count > 0 ? p99 : 0.f, std::memory_order_relaxed);
+        summary.max.store(histogram.max, std::memory_order_relaxed);
+        histogram = {};
+    }
+    version.fetch_add(1, std::memory_order_release);
+}
+#else
+void TelemetryCollector::addSource(StageTelemetry*) {}
+
+void TelemetryCollector::clearSources() {}
+
+void TelemetryCollector::start() {}
+
+void TelemetryCollector::stop() {}
+
+TelemetryCollector::Snapshot TelemetryCollector::getSnapshot() const {
+    return {};
+}
+#endif
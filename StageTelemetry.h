@@ -0,0 +1,159 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "FrameWorker.h"
+
+#ifndef PRESCIENT_TELEMETRY
+#define PRESCIENT_TELEMETRY 0
+#endif
+
+/**
+ * @brief Timing probes of the processing stages of one effect instance, or of the processor's blocks.
+ *
+ * The thread processing the instance records durations into a lock-free queue, a TelemetryCollector drains it.
+ * Only builds configured with PRESCIENT_TELEMETRY measure anything, otherwise every call compiles to nothing.
+ */
+class StageTelemetry {
+public:
+    /**
+     * @brief What a duration was measured around: the stages of a frame, the whole frame of one channel,
+     * and the processor's processBlock.
+     */
+    enum class Probe {
+        ShiftVoices, MatchShifted, VoiceAnalysis, CarrierResiduals, Synthesis, Mix, Frame, Block
+    };
+    static constexpr int numProbes = 8;
+
+    /**
+     * @brief Name of a probe, as shown in the GUI.
+     */
+    inline static const char* getName(Probe probe);
+
+#if PRESCIENT_TELEMETRY
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    static TimePoint start() {
+        return std::chrono::steady_clock::now();
+    }
+
+    /**
+     * @brief Records the time since start. Lock-free, dropped when the collector falls behind.
+     */
+    inline void record(Probe probe, TimePoint start);
+
+    /**
+     * @brief Adds the time since start to the stage of the frame in progress, a stage can take several steps.
+     */
+    inline void addStage(Probe probe, TimePoint start);
+
+    /**
+     * @brief Records the stages of the frame in progress and their sum as Probe::Frame.
+     */
+    inline void endFrame();
+
+    struct Sample {
+        Probe probe = Probe::Block;
+        float microseconds = 0.f;
+    };
+
+    /**
+     * @brief Takes the oldest recorded duration, called by the collector only.
+     */
+    bool pop(Sample& sample) {
+        return samples.pop(sample);
+    }
+
+private:
+    SpscQueue<Sample, 512> samples;
+    // writer side: time of each stage of the frame in progress
+    std::array<std::chrono::steady_clock::duration, numProbes> frameTimes{};
+#else
+    struct TimePoint {};
+
+    static TimePoint start() {
+        return {};
+    }
+    void record(Probe, TimePoint) {}
+    void addStage(Probe, TimePoint) {}
+    void endFrame() {}
+#endif
+};
+
+/**
+ * @brief Background thread that drains the telemetry of the processor and its effects into histograms and
+ * publishes a summary of every interval.
+ *
+ * Sources are registered while the collector is stopped. The summary is read lock-free from any thread.
+ */
+class TelemetryCollector {
+public:
+    /**
+     * @brief Durations of one probe over the last interval, in microseconds. Count is 0 if nothing was measured.
+     */
+    struct Summary {
+        int count = 0;
+        float min = 0.f;
+        float mean = 0.f;
+        float p99 = 0.f;
+        float max = 0.f;
+    };
+    using Snapshot = std::array<Summary, StageTelemetry::numProbes>;
+
+    TelemetryCollector() = default;
+    inline ~TelemetryCollector();
+
+    inline void addSource(StageTelemetry* source);
+    inline void clearSources();
+    inline void start();
+    inline void stop();
+
+    /**
+     * @brief The summary of the last complete interval. Never blocks, retries while it is being published.
+     */
+    [[nodiscard]] inline Snapshot getSnapshot() const;
+
+private:
+#if PRESCIENT_TELEMETRY
+    inline void run();
+    inline void drain();
+    inline void publish();
+
+    // logarithmic bins from 0.25 us, 8 per octave, so that the 99th percentile is within 9%
+    static constexpr int numBins = 192;
+    static constexpr int binsPerOctave = 8;
+    static constexpr float firstBin = 0.25f;
+    static constexpr auto drainInterval = std::chrono::milliseconds(50);
+    static constexpr int drainsPerSummary = 20;
+
+    struct Histogram {
+        std::array<int, numBins> bins{};
+        int count = 0;
+        double sum = 0.0;
+        float min = 0.f;
+        float max = 0.f;
+    };
+    std::array<Histogram, StageTelemetry::numProbes> histograms;
+
+    struct PublishedSummary {
+        std::atomic<int> count{0};
+        std::atomic<float> min{0.f};
+        std::atomic<float> mean{0.f};
+        std::atomic<float> p99{0.f};
+        std::atomic<float> max{0.f};
+    };
+    // seqlock: odd while the summaries are being written
+    std::atomic<unsigned int> version{0};
+    std::array<PublishedSummary, StageTelemetry::numProbes> published;
+
+    std::vector<StageTelemetry*> sources;
+    std::thread thread;
+    std::mutex wakeLock;
+    std::condition_variable wake;
+    bool running = false;
+#endif
+};